@@ -0,0 +1,364 @@
+#ifndef BLOCK_GRID_H
+#define BLOCK_GRID_H
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "message_types.h"
+
+// Zasięg wybuchu bomby: krzyż o środku center, sięgający o podaną liczbę pól
+// w każdym kierunku.
+struct blast_t {
+    position_t center;
+    coords_t left;
+    coords_t right;
+    coords_t down;
+    coords_t up;
+
+    // Metoda wywołująca f dla środka wybuchu i ostatniego pola każdego
+    // niepustego ramienia. Tylko na tych polach mogą stać niszczone bloki,
+    // bo ramię kończy się na pierwszym bloku.
+    template<class F>
+    void for_each_end(F f) const {
+        f(center);
+        if (left > 0)
+            f(position_t{static_cast<coords_t>(center.x - left), center.y});
+        if (right > 0)
+            f(position_t{static_cast<coords_t>(center.x + right), center.y});
+        if (down > 0)
+            f(position_t{center.x, static_cast<coords_t>(center.y - down)});
+        if (up > 0)
+            f(position_t{center.x, static_cast<coords_t>(center.y + up)});
+    }
+};
+
+// Klasa przechowująca zbiór zajętych pól planszy, np. przez bloki. Dla plansz o
+// co najwyżej DENSE_LIMIT polach zbiór jest bitmapą, w której każdy wiersz
+// zajmuje całą liczbę słów 64-bitowych, więc sprawdzenie pola to test
+// jednego bitu, a czyszczenie i przeglądanie zbioru odbywa się po całych
+// słowach. Druga kopia bitmapy jest ułożona kolumnami, dzięki czemu pierwszy
+// blok na promieniu wybuchu, w każdym z czterech kierunków, znajduje się
+// skanując słowa instrukcjami countr_zero/countl_zero, po 64 pola naraz.
+// Większe plansze używają zbioru haszującego.
+class BlockGrid {
+public:
+    // Największa liczba pól planszy, dla której używana jest bitmapa.
+    static constexpr size_t DENSE_LIMIT = size_t{1} << 24;
+
+private:
+    using word_t = uint64_t;
+    static constexpr size_t WORD_BITS = 64;
+
+    const coords_t size_x;
+    const coords_t size_y;
+    const bool dense;
+    const size_t row_words;    // Liczba słów w jednym wierszu bitmapy.
+    const size_t column_words; // Liczba słów w jednej kolumnie bitmapy.
+    std::vector<word_t> bits;    // Bitmapa ułożona wierszami.
+    std::vector<word_t> columns; // Bitmapa ułożona kolumnami.
+    position_set sparse;
+
+    // Maska bitów jednego słowa bitmapy.
+    struct word_mask_t {
+        size_t index;
+        word_t mask;
+    };
+    // Maski zbierane przez insert_all i erase_all. Bufory są używane
+    // ponownie, więc operacje zbiorcze nie alokują pamięci po kilku turach.
+    std::vector<word_mask_t> row_masks;
+    std::vector<word_mask_t> column_masks;
+
+    size_t word_index(const position_t p) const {
+        return p.y * row_words + p.x / WORD_BITS;
+    }
+
+    static word_t bit_mask(const position_t p) {
+        return word_t{1} << (p.x % WORD_BITS);
+    }
+
+    size_t column_word_index(const position_t p) const {
+        return p.x * column_words + p.y / WORD_BITS;
+    }
+
+    static word_t column_bit_mask(const position_t p) {
+        return word_t{1} << (p.y % WORD_BITS);
+    }
+
+    // Funkcja znajdująca najmniejszy ustawiony bit o indeksie z przedziału
+    // [from, to] w ciągu słów line.
+    static std::optional<size_t> first_set(const word_t *line,
+                                           const size_t from,
+                                           const size_t to) {
+        for (size_t w = from / WORD_BITS; w <= to / WORD_BITS; w++) {
+            word_t word = line[w];
+            if (w == from / WORD_BITS)
+                word &= ~word_t{0} << (from % WORD_BITS);
+            if (w == to / WORD_BITS)
+                word &= ~word_t{0} >> (WORD_BITS - 1 - to % WORD_BITS);
+            if (word != 0)
+                return w * WORD_BITS
+                       + static_cast<size_t>(std::countr_zero(word));
+        }
+        return std::nullopt;
+    }
+
+    // Funkcja znajdująca największy ustawiony bit o indeksie z przedziału
+    // [to, from] w ciągu słów line.
+    static std::optional<size_t> last_set(const word_t *line,
+                                          const size_t from,
+                                          const size_t to) {
+        for (size_t w = from / WORD_BITS + 1; w-- > to / WORD_BITS;) {
+            word_t word = line[w];
+            if (w == from / WORD_BITS)
+                word &= ~word_t{0} >> (WORD_BITS - 1 - from % WORD_BITS);
+            if (w == to / WORD_BITS)
+                word &= ~word_t{0} << (to % WORD_BITS);
+            if (word != 0)
+                return w * WORD_BITS + WORD_BITS - 1
+                       - static_cast<size_t>(std::countl_zero(word));
+        }
+        return std::nullopt;
+    }
+
+    // Funkcja wywołująca f dla indeksu każdego ustawionego bitu z przedziału
+    // [from, to] w ciągu słów line.
+    template<class F>
+    static void for_each_set(const word_t *line, const size_t from,
+                             const size_t to, F f) {
+        for (size_t w = from / WORD_BITS; w <= to / WORD_BITS; w++) {
+            word_t word = line[w];
+            if (w == from / WORD_BITS)
+                word &= ~word_t{0} << (from % WORD_BITS);
+            if (w == to / WORD_BITS)
+                word &= ~word_t{0} >> (WORD_BITS - 1 - to % WORD_BITS);
+            while (word != 0) {
+                f(w * WORD_BITS + static_cast<size_t>(std::countr_zero(word)));
+                word &= word - 1;
+            }
+        }
+    }
+
+    // Funkcja wyznaczająca długość promienia wybuchu idącego od pola
+    // origin w górę indeksów linii o długości length. Promień kończy się na
+    // pierwszym bloku (włącznie), krawędzi planszy lub po radius polach.
+    static coords_t forward_ray(const word_t *line, const size_t origin,
+                                const size_t length, const size_t radius) {
+        if (radius == 0 || origin + 1 >= length)
+            return 0;
+        size_t end = std::min(origin + radius, length - 1);
+        auto hit = first_set(line, origin + 1, end);
+        return static_cast<coords_t>((hit ? *hit : end) - origin);
+    }
+
+    // Funkcja wyznaczająca długość promienia wybuchu idącego od pola
+    // origin w dół indeksów linii.
+    static coords_t backward_ray(const word_t *line, const size_t origin,
+                                 const size_t radius) {
+        if (radius == 0 || origin == 0)
+            return 0;
+        size_t end = origin >= radius ? origin - radius : 0;
+        auto hit = last_set(line, origin - 1, end);
+        return static_cast<coords_t>(origin - (hit ? *hit : end));
+    }
+
+    // Metoda zbierająca maski bitów pól positions w obu bitmapach.
+    template<class Range>
+    void collect_masks(const Range &positions) {
+        for (const auto &p: positions) {
+            row_masks.push_back({word_index(p), bit_mask(p)});
+            column_masks.push_back({column_word_index(p), column_bit_mask(p)});
+        }
+    }
+
+    // Funkcja łącząca maski tego samego słowa i wywołująca f(słowo, maska)
+    // raz dla każdego słowa, którego dotyczą maski. Zużyte maski są usuwane.
+    template<class F>
+    static void apply_masks(std::vector<word_mask_t> &masks,
+                            std::vector<word_t> &words, F f) {
+        std::sort(masks.begin(), masks.end(),
+                  [](const word_mask_t &a, const word_mask_t &b) {
+                      return a.index < b.index;
+                  });
+        for (size_t i = 0; i < masks.size();) {
+            const size_t index = masks[i].index;
+            word_t mask = 0;
+            for (; i < masks.size() && masks[i].index == index; i++)
+                mask |= masks[i].mask;
+            f(words[index], mask);
+        }
+        masks.clear();
+    }
+
+    // Wersja dla zbioru haszującego, sprawdzająca pole po polu.
+    coords_t sparse_ray(position_t p, const int dx, const int dy,
+                        const size_t radius) const {
+        coords_t length = 0;
+        while (length < radius) {
+            if ((dx < 0 && p.x == 0) || (dx > 0 && p.x + 1 >= size_x)
+                || (dy < 0 && p.y == 0) || (dy > 0 && p.y + 1 >= size_y))
+                break;
+            p.x = static_cast<coords_t>(p.x + dx);
+            p.y = static_cast<coords_t>(p.y + dy);
+            length++;
+            if (sparse.contains(p)) break;
+        }
+        return length;
+    }
+
+public:
+    BlockGrid(const coords_t _size_x, const coords_t _size_y) :
+            size_x(_size_x), size_y(_size_y),
+            dense(size_t{_size_x} * _size_y <= DENSE_LIMIT),
+            row_words((_size_x + WORD_BITS - 1) / WORD_BITS),
+            column_words((_size_y + WORD_BITS - 1) / WORD_BITS) {
+        if (dense) {
+            bits.assign(row_words * size_y, 0);
+            columns.assign(column_words * size_x, 0);
+        }
+    }
+
+    // Metoda sprawdzająca, czy na polu p jest blok. Pole musi leżeć na
+    // planszy.
+    bool contains(const position_t p) const {
+        if (!dense)
+            return sparse.contains(p);
+        return (bits[word_index(p)] & bit_mask(p)) != 0;
+    }
+
+    // Metoda stawiająca blok na polu p.
+    // return - false, jeżeli na polu był już blok
+    bool insert(const position_t p) {
+        if (!dense)
+            return sparse.insert(p).second;
+        word_t &word = bits[word_index(p)];
+        bool inserted = (word & bit_mask(p)) == 0;
+        word |= bit_mask(p);
+        columns[column_word_index(p)] |= column_bit_mask(p);
+        return inserted;
+    }
+
+    // Metoda usuwająca blok z pola p.
+    void erase(const position_t p) {
+        if (!dense) {
+            sparse.erase(p);
+        }
+        else {
+            bits[word_index(p)] &= ~bit_mask(p);
+            columns[column_word_index(p)] &= ~column_bit_mask(p);
+        }
+    }
+
+    // Metody stawiające lub usuwające bloki na wszystkich polach z zakresu.
+    // Bity pól leżących w tym samym słowie bitmapy są łączone w jedną maskę,
+    // więc każde słowo jest modyfikowane jedną operacją.
+    template<class Range>
+    void insert_all(const Range &positions) {
+        if (!dense) {
+            sparse.insert(positions.begin(), positions.end());
+            return;
+        }
+        collect_masks(positions);
+        auto set = [](word_t &word, const word_t mask) { word |= mask; };
+        apply_masks(row_masks, bits, set);
+        apply_masks(column_masks, columns, set);
+    }
+
+    template<class Range>
+    void erase_all(const Range &positions) {
+        if (!dense) {
+            for (const auto &p: positions)
+                sparse.erase(p);
+            return;
+        }
+        collect_masks(positions);
+        auto reset = [](word_t &word, const word_t mask) { word &= ~mask; };
+        apply_masks(row_masks, bits, reset);
+        apply_masks(column_masks, columns, reset);
+    }
+
+    void clear() {
+        if (!dense) {
+            sparse.clear();
+        }
+        else {
+            std::fill(bits.begin(), bits.end(), 0);
+            std::fill(columns.begin(), columns.end(), 0);
+        }
+    }
+
+    // Metoda wyznaczająca zasięg wybuchu bomby leżącej na polu center.
+    // Wybuch na bloku nie wychodzi poza swoje pole.
+    // - radius - zasięg wybuchu w każdym kierunku
+    blast_t blast(const position_t center, const size_t radius) const {
+        blast_t b{center, 0, 0, 0, 0};
+        if (contains(center))
+            return b;
+        if (!dense) {
+            b.left = sparse_ray(center, -1, 0, radius);
+            b.right = sparse_ray(center, 1, 0, radius);
+            b.down = sparse_ray(center, 0, -1, radius);
+            b.up = sparse_ray(center, 0, 1, radius);
+            return b;
+        }
+        const word_t *row = &bits[center.y * row_words];
+        const word_t *column = &columns[center.x * column_words];
+        b.left = backward_ray(row, center.x, radius);
+        b.right = forward_ray(row, center.x, size_x, radius);
+        b.down = backward_ray(column, center.y, radius);
+        b.up = forward_ray(column, center.y, size_y, radius);
+        return b;
+    }
+
+    // Metoda wywołująca f dla każdego zajętego pola w zasięgu wybuchu b.
+    template<class F>
+    void for_each_in(const blast_t &b, F f) const {
+        const position_t c = b.center;
+        if (!dense) {
+            for (size_t x = c.x - b.left; x <= size_t{c.x} + b.right; x++) {
+                position_t p{static_cast<coords_t>(x), c.y};
+                if (sparse.contains(p))
+                    f(p);
+            }
+            for (size_t y = c.y - b.down; y <= size_t{c.y} + b.up; y++) {
+                position_t p{c.x, static_cast<coords_t>(y)};
+                if (y != c.y && sparse.contains(p))
+                    f(p);
+            }
+            return;
+        }
+        for_each_set(&bits[c.y * row_words], c.x - b.left, c.x + b.right,
+                     [&](const size_t x) {
+                         f(position_t{static_cast<coords_t>(x), c.y});
+                     });
+        for_each_set(&columns[c.x * column_words], c.y - b.down, c.y + b.up,
+                     [&](const size_t y) {
+                         if (y != c.y)
+                             f(position_t{c.x, static_cast<coords_t>(y)});
+                     });
+    }
+
+    // Metoda zwracająca wszystkie pola z blokami. Bitmapa jest przeglądana
+    // słowami, a puste słowa są pomijane bez sprawdzania pojedynczych bitów.
+    std::vector<position_t> positions() const {
+        if (!dense)
+            return {sparse.begin(), sparse.end()};
+
+        std::vector<position_t> result;
+        for (size_t i = 0; i < bits.size(); i++) {
+            word_t word = bits[i];
+            while (word != 0) {
+                size_t bit = static_cast<size_t>(std::countr_zero(word));
+                word &= word - 1;
+                result.push_back({
+                    static_cast<coords_t>(i % row_words * WORD_BITS + bit),
+                    static_cast<coords_t>(i / row_words)});
+            }
+        }
+        return result;
+    }
+};
+
+#endif // BLOCK_GRID_H
@@ -4,34 +4,103 @@
 #include <optional>
 #include <functional>
 #include <exception>
-#include <queue>
+#include <vector>
+#include <utility>
+#include <algorithm>
 
 #include <boost/thread.hpp>
 
-/* Szablon klasy implementująca kolejkę blokującą. */
+/* Zachowanie kolejki o ograniczonej pojemności, gdy jest ona pełna. */
+enum class OverflowPolicy {
+    BLOCK,       // push czeka, aż zwolni się miejsce
+    DROP_OLDEST, // push usuwa najstarszy element kolejki
+    REJECT       // push nie wstawia elementu i zwraca false
+};
+
+/* Szablon klasy implementująca kolejkę blokującą. Elementy są trzymane w
+ * buforze cyklicznym. Kolejka o ograniczonej pojemności alokuje bufor raz,
+ * przy tworzeniu, a nieograniczona powiększa go dwukrotnie, gdy się zapełni.
+ */
 template<class T>
 class BlockingQueue {
 private:
     boost::mutex mutex;
     boost::condition_variable pop_q;
-    std::queue<T> q{};
+    boost::condition_variable push_q;
+    std::vector<T> ring;
+    size_t first;  // Indeks początku kolejki w buforze.
+    size_t count;  // Liczba elementów w kolejce.
+    const size_t capacity; // Pojemność kolejki, 0 oznacza brak ograniczenia.
+    const OverflowPolicy policy;
+
+    void grow() {
+        std::vector<T> bigger(std::max<size_t>(16, 2 * ring.size()));
+        for (size_t i = 0; i < count; i++)
+            bigger[i] = std::move(ring[(first + i) % ring.size()]);
+        ring.swap(bigger);
+        first = 0;
+    }
+
+    /* Metoda usuwa element z początku niepustej kolejki. Wymaga zajętego
+     * mutexa.
+     */
+    T take() {
+        T v = std::move(ring[first]);
+        first = (first + 1) % ring.size();
+        count--;
+        push_q.notify_one();
+        return v;
+    }
+
+    template<class V>
+    bool put(V &&v) {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (capacity > 0 && count == capacity) {
+            switch (policy) {
+                case OverflowPolicy::BLOCK:
+                    while (count == capacity)
+                        push_q.wait(lock);
+                    break;
+                case OverflowPolicy::DROP_OLDEST:
+                    take();
+                    break;
+                case OverflowPolicy::REJECT:
+                    return false;
+            }
+        }
+        if (count == ring.size())
+            grow();
+        ring[(first + count) % ring.size()] = std::forward<V>(v);
+        count++;
+        pop_q.notify_one();
+        return true;
+    }
+
 public:
-    BlockingQueue() {};
+    /* Konstruktor kolejki.
+     * argumenty:
+     * - _capacity - maksymalna liczba elementów, 0 oznacza brak ograniczenia
+     * - _policy - zachowanie push, gdy kolejka jest pełna
+     */
+    explicit BlockingQueue(const size_t _capacity = 0,
+                           const OverflowPolicy _policy = OverflowPolicy::BLOCK) :
+            ring(_capacity), first(0), count(0), capacity(_capacity),
+            policy(_policy) {};
+
+    BlockingQueue(const BlockingQueue &) = delete;
+    BlockingQueue &operator=(const BlockingQueue &) = delete;
 
     /* Metoda atomowo umieszcza element na końcu kolejki.
      * argumenty:
      * - v - element do wrzucenia na koniec kolejki
+     * return - false, jeżeli kolejka była pełna i element został odrzucony
      */
-    void push(T &v) {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        q.push(v);
-        pop_q.notify_one();
+    bool push(const T &v) {
+        return put(v);
     }
 
-    void push(T &&v) {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        q.push(v);
-        pop_q.notify_one();
+    bool push(T &&v) {
+        return put(std::move(v));
     }
 
     /* Metoda atomowo usuwa element z początku kolejki i go zwraca. W przypadku,
@@ -40,14 +109,59 @@ public:
      */
     T pop() {
         boost::unique_lock<boost::mutex> lock(mutex);
-        while (q.empty()) {
+        while (count == 0) {
             pop_q.wait(lock);
         }
-        T v = q.front();
-        q.pop();
-        pop_q.notify_one();
-        return v;
+        return take();
+    }
+
+    /* Metoda atomowo usuwa element z początku kolejki i go zwraca. Nie
+     * wstrzymuje wątku.
+     * return - wartość z początku kolejki lub nullopt, gdy kolejka jest pusta.
+     */
+    std::optional<T> try_pop() {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (count == 0)
+            return std::nullopt;
+        return take();
+    }
+
+    /* Metoda atomowo usuwa wszystkie elementy z kolejki. */
+    void clear() {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while (count > 0)
+            take();
+    }
+
+    /* Metoda atomowo usuwa z kolejki elementy spełniające predykat,
+     * zachowując kolejność pozostałych.
+     * argumenty:
+     * - pred - predykat wywoływany dla każdego elementu pod mutexem kolejki
+     */
+    template<class Pred>
+    void erase_if(Pred pred) {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        size_t kept = 0;
+        for (size_t i = 0; i < count; i++) {
+            T &v = ring[(first + i) % ring.size()];
+            if (pred(v)) continue;
+            if (kept != i)
+                ring[(first + kept) % ring.size()] = std::move(v);
+            kept++;
+        }
+        for (size_t i = kept; i < count; i++)
+            ring[(first + i) % ring.size()] = T();
+        if (kept < count) {
+            count = kept;
+            push_q.notify_all();
+        }
+    }
+
+    /* Metoda zwracająca liczbę elementów w kolejce. */
+    size_t size() {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        return count;
     }
 };
 
-#endif // BLOCKING_QUEUE
\ No newline at end of file
+#endif // BLOCKING_QUEUE
@@ -12,6 +12,7 @@
 
 #include "connection.h"
 #include "message_types.h"
+#include "message_schema.h"
 #include "command_parser.h"
 
 using std::cout;
@@ -29,6 +30,11 @@ using std::exception;
 namespace po = boost::program_options;
 
 namespace {
+    // Reader komunikatów od serwera i writery do serwera i do gui.
+    using ServerReader = BasicDatagramReader<TCPClient>;
+    using ServerWriter = BasicDatagramWriter<TCPClient>;
+    using GuiWriter = BasicDatagramWriter<UDPClient>;
+
     // Enumerator wskazujący na stan gracza.
     enum StateType {
         IDLE,   // Stan w którym gracz czeka na Hello od serwera.
@@ -116,7 +122,7 @@ namespace {
     // player_name - imię gracza, które zostało podane podczas
     //               uruchomienia programu
     void send_join(const string &player_name) {
-        DatagramWriter buf(TCPClient::get_instance());
+        ServerWriter buf(TCPClient::get_instance());
         message_id_t tmp = CS_JOIN;
         buf.write(tmp)->write(player_name)->send();
     }
@@ -168,17 +174,11 @@ namespace {
     // Funkcja przetwarzająca komunikat HELLO.
     // server_handler - reader komunikatów od serwera
     // return - struktura zawierająca informację z komunikatu hello.
-    hello_t handle_hello(DatagramReader &server_handler) {
+    hello_t handle_hello(ServerReader &server_handler) {
         hello_t res;
         message_id_t m;
-        server_handler.read(m)
-                ->read(res.server_name)
-                ->read(res.players_count)
-                ->read(res.size_x)
-                ->read(res.size_y)
-                ->read(res.game_length)
-                ->read(res.explosion_radius)
-                ->read(res.bomb_timer);
+        server_handler.read(m);
+        hello_schema::read(server_handler, res);
 
         return res;
     }
@@ -196,17 +196,15 @@ namespace {
         // Metoda czytająca komunikat ACCEPTED_PLAYER i
         // aktualizująca mapę graczy.
         // accepted_player - reader serwera
-        void add_player(DatagramReader &accepted_player) {
-            player_num_t player_id;
-            player_t player;
-            accepted_player.read(player_id);
-            accepted_player.read(player);
-            player_map[player_id] = player;
+        void add_player(ServerReader &accepted_player) {
+            accepted_player_t m;
+            accepted_player_schema::read(accepted_player, m);
+            player_map[m.id] = m.player;
         }
 
         // Metoda wysyłająca komunikat LOBBY do gui.
         // gui_handler - writer do gui
-        void send(DatagramWriter &gui_handler) const {
+        void send(GuiWriter &gui_handler) const {
             gui_handler.clear();
             gui_handler.write(CG_LOBBY)
                     ->write(hello.server_name)
@@ -242,12 +240,10 @@ namespace {
         // Metoda wczytująca informacje o nowej
         // bombie od serwera i aktualizująca stan.
         // turn - reader od serwera
-        void handle_bomb_placed(DatagramReader &turn) {
-            bomb_id_t bomb_id;
-            bomb_t new_bomb;
-            new_bomb.timer = game_info.bomb_timer;
-            turn.read(bomb_id)->read(new_bomb.position);
-            bombs[bomb_id] = new_bomb;
+        void handle_bomb_placed(ServerReader &turn) {
+            bomb_placed_t m;
+            bomb_placed_schema::read(turn, m);
+            bombs[m.bomb_id] = {m.position, game_info.bomb_timer};
         }
 
         // Metoda sprawdzająca, czy dane współrzędne mogą się
@@ -292,7 +288,7 @@ namespace {
 
         // Metoda obsługująca zdarzenie BOMB_EXPLODED.
         // turn - reader od serwera
-        void handle_bomb_exploded(DatagramReader &turn) {
+        void handle_bomb_exploded(ServerReader &turn) {
             bomb_id_t bomb_id;
             turn.read(bomb_id);
 
@@ -325,29 +321,28 @@ namespace {
 
         // Metoda obsługująca zdarzenie PLAYER_MOVED.
         // turn - reader od serwera
-        void handle_player_moved(DatagramReader &turn) {
-            player_num_t id;
-            position_t pos;
-            turn.read(id)->read(pos);
-            player_positions[id] = pos;
+        void handle_player_moved(ServerReader &turn) {
+            player_moved_t m;
+            player_moved_schema::read(turn, m);
+            player_positions[m.player_id] = m.position;
         }
 
         // Metoda obsługująca zdarzenie BLOCK_PLACED.
         // turn - reader od serwera
-        void handle_block_placed(DatagramReader &turn) {
-            position_t pos;
-            turn.read(pos);
-            blocks.insert(pos);
+        void handle_block_placed(ServerReader &turn) {
+            block_placed_t m;
+            block_placed_schema::read(turn, m);
+            blocks.insert(m.position);
         }
 
     public:
         // Konstruktor przyjmujący przetworzony komunikat HELLO.
         GameHandler(const hello_t _game_info) :
-                game_info(_game_info) {};
+                game_info(_game_info), current_turn(0) {};
 
         // Metoda obsługująca komunikat GAME_STARTED.
         // gamers - reader od serwera
-        void set_gamers(DatagramReader &gamers) {
+        void set_gamers(ServerReader &gamers) {
             container_size_t gamers_size;
             gamers.read(gamers_size);
             for (container_size_t i = 0; i < gamers_size; i++) {
@@ -361,7 +356,7 @@ namespace {
 
         // Metoda oobsługująca komunikat TURN.
         // turn - reader od serwera.
-        void handle_turn(DatagramReader &turn) {
+        void handle_turn(ServerReader &turn) {
             // Eksplozje trwają jedną turę, więc należy je wyczyścić.
             explosions.clear();
             // Czyszczę struktury pomocniczę.
@@ -372,8 +367,10 @@ namespace {
                 bomb.second.timer--;
             }
 
-            container_size_t events_count;
-            turn.read(current_turn)->read(events_count);
+            turn_header_t header;
+            turn_header_schema::read(turn, header);
+            container_size_t events_count = header.events;
+            current_turn = header.turn;
             for (container_size_t i = 0; i < events_count; i++) {
                 message_id_t event_id;
                 turn.read(event_id);
@@ -406,9 +403,45 @@ namespace {
             }
         }
 
+        // Metoda obsługująca komunikat RESYNC. Kolejna tura jest migawką
+        // stanu gry, która opisuje całą planszę, więc dotychczasowy stan
+        // jest czyszczony. Wyniki przychodzą po migawce w komunikacie
+        // GAME_STATE.
+        void resync() {
+            player_positions.clear();
+            blocks.clear();
+            bombs.clear();
+            explosions.clear();
+        }
+
+        // Metoda obsługująca komunikat GAME_STATE, przysyłany po migawce
+        // stanu gry. Ustawia wyniki graczy i liczniki bomb z migawki.
+        // state - reader od serwera
+        void set_state(ServerReader &state) {
+            container_size_t scores_count;
+            state.read(scores_count);
+            for (container_size_t i = 0; i < scores_count; i++) {
+                player_num_t player_id;
+                score_t score;
+                state.read(player_id)->read(score);
+                scores[player_id] = score;
+            }
+
+            container_size_t bombs_count;
+            state.read(bombs_count);
+            for (container_size_t i = 0; i < bombs_count; i++) {
+                bomb_id_t bomb_id;
+                game_time_t timer;
+                state.read(bomb_id)->read(timer);
+                auto bomb = bombs.find(bomb_id);
+                if (bomb != bombs.end())
+                    bomb->second.timer = timer;
+            }
+        }
+
         // Metoda wysyłająca komunikat GAME do gui.
         // gui_handler - writer do gui.
-        void send(DatagramWriter &gui_handler) const {
+        void send(GuiWriter &gui_handler) const {
             gui_handler.clear();
             gui_handler.write(CG_GAME)
                     ->write(game_info.server_name)
@@ -433,7 +466,7 @@ namespace {
 
 // Funkcja obsługująca komunikat GAME_ENDED.
 // server_handler - reader od serwera
-    void handle_game_ended(DatagramReader &server_handler) {
+    void handle_game_ended(ServerReader &server_handler) {
         container_size_t size;
         server_handler.read(size);
         for (container_size_t i = 0; i < size; i++) {
@@ -446,8 +479,8 @@ namespace {
 // Funkcja odbierająca komunikaty od serwera, przetwarzająca je i wysyłająca
 // odpowiednie komunikaty do gui.
     void from_server_to_gui() {
-        DatagramWriter gui_handler(UDPClient::get_instance());
-        DatagramReader server_handler(TCPClient::get_instance());
+        GuiWriter gui_handler(UDPClient::get_instance());
+        ServerReader server_handler(TCPClient::get_instance());
 
         hello_t hello = handle_hello(server_handler);
         game_state.set_state(StateType::IN_LOBBY);
@@ -476,6 +509,15 @@ namespace {
                     game_info.handle_turn(server_handler);
                     game_info.send(gui_handler);
                     break;
+                case SC_RESYNC:
+                    if (game_state.get_state() != StateType::IN_GAME) continue;
+                    game_info.resync();
+                    break;
+                case SC_GAME_STATE:
+                    if (game_state.get_state() != StateType::IN_GAME) continue;
+                    game_info.set_state(server_handler);
+                    game_info.send(gui_handler);
+                    break;
                 case SC_GAME_ENDED:
                     if (game_state.get_state() != StateType::IN_GAME) continue;
                     handle_game_ended(server_handler);
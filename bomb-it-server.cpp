@@ -12,15 +12,23 @@
 #include <variant>
 #include <random>
 #include <sstream>
+#include <algorithm>
+#include <atomic>
 
 #include <boost/program_options.hpp>
 #include <boost/thread.hpp>
+#include <netinet/tcp.h>
 
 #include "connection.h"
 #include "message_types.h"
+#include "message_schema.h"
 #include "command_parser.h"
 #include "blocking_queue.h"
-#include "latch.h"
+#include "mpsc_queue.h"
+#include "turn_history.h"
+#include "tick_scheduler.h"
+#include "game_engine.h"
+#include "spsc_ring.h"
 
 using std::cout;
 using std::copy_n;
@@ -45,25 +53,49 @@ using std::variant;
 using std::holds_alternative;
 using std::get;
 using std::visit;
-using std::minstd_rand;
 using std::make_pair;
+using std::unique_ptr;
+using std::make_unique;
+using std::get_if;
 
 namespace po = boost::program_options;
 namespace as = boost::asio;
 
-// Implementacja robots-server. Serwer jest zrealizowany wielowątkowo.
-// Istnieje NUMBER_OF_CLIENTS serwerów odbierających i wysyłających bezmyślnie
-// komunikaty do klienta. Odbierane komunikaty od klientów przesyłają do obiektu
-// GameMaster, który je obsługuje. Komunikacja między serwerami, a game masterem
-// jest zrealizowana przez kolejki blokujące. Każdy serwer i game master
-// mają swoje kolejki.
+// Implementacja robots-server. Połączenia z klientami są obsługiwane
+// asynchronicznie przez niewielką pulę wątków sieciowych. Każdy klient ma
+// sesję, która odbiera komunikaty od klienta i przesyła je do obiektu
+// GameMaster, który je obsługuje. Komunikaty od game mastera trafiają do sesji
+// przez kanały oparte na kolejkach. Game master trzyma rejestr kanałów
+// podłączonych sesji i rozsyła komunikaty tylko do nich. Serwer może
+// prowadzić wiele niezależnych pokojów, każdy z własnym game masterem;
+// wszystkie pokoje dzielą gniazdo nasłuchujące i pulę wątków sieciowych.
+// Tury wszystkich pokojów są rozgrywane przez wspólny TickScheduler.
 namespace {
-    // Maksymalna liczba podłączonych klientów.
-    constexpr player_num_t NUMBER_OF_CLIENTS = 25;
-    // Dodatkowy rodzaj wiadomości, mówiący o tym czy nowy klient został
-    // podłączony do jakiegoś serwera, ale jeszcze nie przesłał
-    // żadnego komunikatu.
-    constexpr message_id_t RESET_SERVER = 255;
+    // Dodatkowy rodzaj wiadomości, mówiący o tym, że połączenie z klientem
+    // zostało zamknięte.
+    constexpr message_id_t SESSION_CLOSED = 255;
+    // Rozmiar bufora, do którego sesja odbiera bajty od klienta.
+    constexpr size_t READ_BUFFER_SIZE = 1024;
+    // Maksymalna liczba buforów odczytu dobieranych z gniazda po jednym
+    // odczycie asynchronicznym, zanim sesja sparsuje wejście.
+    constexpr size_t MAX_DRAIN_READS = 4;
+    // Maksymalna liczba komunikatów czekających na wysłanie do klienta.
+    constexpr size_t CHANNEL_CAPACITY = 1024;
+    // Maksymalna liczba komunikatów wysyłanych klientowi jednym zapisem.
+    constexpr size_t MAX_WRITE_BATCH = 256;
+    // Liczba komunikatów, powyżej której zapis nie mieści się w jednym
+    // wywołaniu sendmsg (asio przekazuje do 64 buforów naraz) i gniazdo jest
+    // zatykane na czas zapisu.
+    constexpr size_t CORK_THRESHOLD = 64;
+    // Co ile tur game master zapisuje migawkę stanu gry. Klient podłączony w
+    // trakcie gry dostaje ostatnią migawkę i tury, które po niej nastąpiły.
+    constexpr turn_t KEYFRAME_INTERVAL = 64;
+    // Domyślna liczba tur, o które klient może się opóźnić.
+    constexpr turn_t DEFAULT_MAX_LAG = 100;
+    // Domyślny limit pamięci na historię gry w bajtach.
+    constexpr uint32_t DEFAULT_HISTORY_MEMORY = 4 << 20;
+    // Liczba tur, o które rozsyłanie może się opóźnić względem liczenia tur.
+    constexpr size_t PUBLICATION_QUEUE_SIZE = 4;
 
     // Wyjątek zwracany w wypadku podania zbyt dużej liczby graczy.
     struct TooManyClients : public std::exception {
@@ -72,28 +104,53 @@ namespace {
         }
     };
 
+    // Wyjątek zwracany w wypadku podania opóźnienia, które nie mieści się w
+    // kanale klienta.
+    struct MaxLagTooLarge : public std::exception {
+        const char *what() const throw() {
+            return "Max lag must be smaller than the client channel capacity!";
+        }
+    };
+
     using address_t = string;
-    using server_id_t = uint8_t;
+    using server_id_t = uint32_t;
+    // Writer kodujący komunikaty do klienta w pamięci.
+    using BufferWriter = BasicDatagramWriter<BufferHandler>;
 
     using server_join_t = struct {
         join_t join;
         name_t client_address;
     };
 
+    class ClientChannel;
+
+    // Wiadomość o nowym kliencie, który jeszcze nie przesłał żadnego
+    // komunikatu.
+    using session_opened_t = struct {
+        shared_ptr<ClientChannel> channel;
+    };
+
     using simple_message_t = uint8_t;
+    using client_message_t = variant<server_join_t, simple_message_t,
+                                     session_opened_t>;
+    // Komunikat wczytany z gniazda klienta: zgłoszenie do gry, przekazywane
+    // game masterowi, albo akcja gracza, zapisywana w kanale sesji.
+    using parsed_message_t = variant<server_join_t, player_action_t>;
     using game_master_message_t = struct {
         server_id_t server_id;
-        variant<server_join_t, move_t, simple_message_t> message;
+        client_message_t message;
     };
-    using gm_queue_t = BlockingQueue<game_master_message_t>;
+    using gm_queue_t = MPSCQueue<game_master_message_t>;
+
+    // Zakodowany komunikat gotowy do wysłania. Jest niezmienny, więc wiele
+    // sesji może go wysyłać jednocześnie bez kopiowania.
+    using wire_message_t = shared_ptr<const flex_buf_t>;
 
     using server_message_t = struct {
         message_id_t id;
-        variant<nullptr_t, hello_t, accepted_player_t, player_map_t,
-            game_turn_t, scores_t> data;
+        wire_message_t data;
     };
     using server_queue_t = BlockingQueue<server_message_t>;
-    using  server_queue_list_t = array<server_queue_t, NUMBER_OF_CLIENTS>;
 
     // Szablon pomocniczy wykorzystywany w pattern matchingu.
     template<typename ... Ts>
@@ -102,6 +159,12 @@ namespace {
     };
     template<class... Ts> Overload(Ts...) -> Overload<Ts...>;
 
+    // Sposób obsługi klienta, który nie nadąża z odbieraniem tur.
+    enum SlowClientPolicy {
+        DISCONNECT, // Klient jest rozłączany.
+        RESYNC      // Klient dostaje migawkę stanu gry zamiast zaległych tur.
+    };
+
     enum GameState {
         GAME,
         LOBBY
@@ -120,6 +183,13 @@ namespace {
         seed_t seed;
         coords_t size_x;
         coords_t size_y;
+        uint16_t io_threads;
+        uint32_t history_memory;
+        turn_t max_lag;
+        SlowClientPolicy slow_client_policy;
+        uint16_t rooms;
+        uint16_t tick_threads;
+        bool verbose;
     };
 
     // Funkcja przetwarzająca parametry przekazane podczas włączenia programu.
@@ -130,6 +200,14 @@ namespace {
     optional<command_parameters_t> parse_parameters(int argc, char *argv[]) {
         command_parameters_t command_parameters;
         command_parameters.seed = 0;  // Domyślny seed.
+        command_parameters.history_memory = DEFAULT_HISTORY_MEMORY;
+        command_parameters.max_lag = DEFAULT_MAX_LAG;
+        command_parameters.slow_client_policy = DISCONNECT;
+        command_parameters.rooms = 1;
+        command_parameters.io_threads = static_cast<uint16_t>(
+            std::max(1u, boost::thread::hardware_concurrency()));
+        command_parameters.tick_threads = command_parameters.io_threads;
+        command_parameters.verbose = false;
         bool with_help = false;
 
         vector<flag_t> flags{
@@ -161,6 +239,18 @@ namespace {
                     command_parameters.explosion_radius =
                         vm["explosion-radius"].as<explosion_radius_t>();
                 }},
+            {"max-lag", "g", po::value<turn_t>(), false,
+                "<u16, parametr opcjonalny, dopuszczalne opóźnienie klienta "
+                "w turach>",
+                [&](po::variables_map &vm) {
+                    // Kanał klienta musi pomieścić max_lag tur, inaczej
+                    // klient zostałby rozłączony przy pełnym kanale, zanim
+                    // przekroczy dopuszczalne opóźnienie.
+                    turn_t arg = vm["max-lag"].as<turn_t>();
+                    if (arg >= CHANNEL_CAPACITY)
+                        throw MaxLagTooLarge();
+                    command_parameters.max_lag = arg;
+                }},
             {"help", "h", nullopt, false, "Wypisuje jak używać programu",
                 [&](po::options_description &desc) {
                     cout << desc << endl;
@@ -176,21 +266,57 @@ namespace {
                     command_parameters.game_length =
                         vm["game-length"].as<game_time_t>();
                 }},
+            {"history-memory", "m", po::value<uint32_t>(), false,
+                "<u32, parametr opcjonalny, limit pamięci historii w bajtach>",
+                [&](po::variables_map &vm) {
+                    command_parameters.history_memory =
+                        vm["history-memory"].as<uint32_t>();
+                }},
             {"server-name", "n", po::value<string>(), true, "<String>",
                 [&](po::variables_map &vm) {
                     command_parameters.server_name =
                             vm["server-name"].as<string>();
                 }},
+            {"rooms", "o", po::value<uint16_t>(), false,
+                "<u16, parametr opcjonalny, liczba pokojów z osobnymi grami>",
+                [&](po::variables_map &vm) {
+                    command_parameters.rooms =
+                        std::max<uint16_t>(1, vm["rooms"].as<uint16_t>());
+                }},
             {"port", "p", po::value<port_t>(), true, "<u16>",
                 [&](po::variables_map &vm) {
                     command_parameters.port = vm["port"].as<port_t>();
                 }},
+            {"resync-slow-clients", "r", nullopt, false,
+                "Opóźniony klient dostaje migawkę stanu gry zamiast "
+                "zostać rozłączony (wymaga klienta obsługującego "
+                "komunikat resync)",
+                [&](po::options_description &) {
+                    command_parameters.slow_client_policy = RESYNC;
+                }},
             {"seed", "s", po::value<seed_t>(), false,
                 "<u32, parametr opcjonalny>",
                 [&](po::variables_map &vm) {
                     command_parameters.seed =
                         vm["seed"].as<seed_t>();
                 }},
+            {"io-threads", "t", po::value<uint16_t>(), false,
+                "<u16, parametr opcjonalny, liczba wątków sieciowych>",
+                [&](po::variables_map &vm) {
+                    command_parameters.io_threads =
+                        std::max<uint16_t>(1, vm["io-threads"].as<uint16_t>());
+                }},
+            {"verbose", "v", nullopt, false,
+                "Wypisuje statystyki każdej gry na standardowe wyjście błędów",
+                [&](po::options_description &) {
+                    command_parameters.verbose = true;
+                }},
+            {"tick-threads", "w", po::value<uint16_t>(), false,
+                "<u16, parametr opcjonalny, liczba wątków rozgrywających tury>",
+                [&](po::variables_map &vm) {
+                    command_parameters.tick_threads =
+                        std::max<uint16_t>(1, vm["tick-threads"].as<uint16_t>());
+                }},
             {"size-x", "x", po::value<coords_t>(), true, "<u16>",
                 [&](po::variables_map &vm) {
                     command_parameters.size_x =
@@ -211,81 +337,75 @@ namespace {
             return nullopt;
     }
 
-    // Funkcja odbierająca komunikaty od klienta i przesyłająca je do game
-    // mastera.
-    // - game_master_queue - kolejka na której słucha game master
-    // - dr - reader od klienta
-    // - server_id - id tego serwera
+    // Funkcja wczytująca jeden komunikat klienta z początku bufora.
+    // - buf - bajty odebrane od klienta
+    // - len - liczba bajtów w buforze
     // - client_address - adres klienta
-    void receive_from_client(gm_queue_t &game_master_queue, DatagramReader &dr,
-                             server_id_t server_id, address_t client_address) {
-        game_master_message_t gm_mess;
-        gm_mess.server_id = server_id;
-        while (true) {
-            message_id_t m;
-            dr.read(m);
-            switch (m) {
-                case CS_JOIN:
-                    join_t join;
-                    dr.read(join.name);
-                    server_join_t server_join;
-                    server_join.join = join;
-                    server_join.client_address = string_to_name(client_address);
-                    gm_mess.message = server_join;
-                    game_master_queue.push(gm_mess);
-                    break;
-                case CS_PLACE_BOMB:
-                case CS_PLACE_BLOCK:
-                    gm_mess.message = m;
-                    game_master_queue.push(gm_mess);
-                    break;
-                case CS_MOVE:
-                    move_t move;
-                    direction_t d;
-                    dr.read(d);
-                    if (d > MAX_DIRECTION)
-                        throw exception();
-                    move.direction = static_cast<Direction>(d);
-                    gm_mess.message = move;
-                    game_master_queue.push(gm_mess);
-                    break;
-                default:
+    // - consumed - liczba bajtów zajętych przez wczytany komunikat
+    // return - wczytany komunikat lub nullopt, jeżeli bufor nie zawiera
+    //          jeszcze całego komunikatu
+    // Rzuca wyjątek, gdy komunikat jest niepoprawny.
+    optional<parsed_message_t> parse_client_message(const char *buf,
+                                                    size_t len,
+                                                    const name_t &client_address,
+                                                    size_t &consumed) {
+        if (len == 0) return nullopt;
+        message_id_t m = static_cast<message_id_t>(buf[0]);
+        switch (m) {
+            case CS_JOIN: {
+                if (len < 2) return nullopt;
+                uint8_t name_len = static_cast<uint8_t>(buf[1]);
+                if (len < 2u + name_len) return nullopt;
+                server_join_t server_join;
+                copy_n(buf + 2, name_len, server_join.join.name.name.begin());
+                server_join.join.name.len = name_len;
+                server_join.client_address = client_address;
+                consumed = 2u + name_len;
+                return server_join;
+            }
+            case CS_PLACE_BOMB:
+                consumed = 1;
+                return player_action_t{PLACE_BOMB};
+            case CS_PLACE_BLOCK:
+                consumed = 1;
+                return player_action_t{PLACE_BLOCK};
+            case CS_MOVE: {
+                if (len < 2) return nullopt;
+                direction_t d = static_cast<direction_t>(buf[1]);
+                if (d > MAX_DIRECTION)
                     throw exception();
+                move_t move;
+                move.direction = static_cast<Direction>(d);
+                consumed = 2;
+                return player_action_t{move};
             }
+            default:
+                throw exception();
         }
     }
 
     // Funkcja wysyłająca komunikat hello do klienta.
     // - hello - komunikat do przesłania
     // - dw - writer do klienta
-    void send_hello(hello_t &hello, DatagramWriter &dw) {
+    void send_hello(hello_t &hello, BufferWriter &dw) {
         dw.clear();
-        dw.write(SC_HELLO)
-                ->write(hello.server_name)
-                ->write(hello.players_count)
-                ->write(hello.size_x)
-                ->write(hello.size_y)
-                ->write(hello.game_length)
-                ->write(hello.explosion_radius)
-                ->write(hello.bomb_timer)
-                ->send();
+        hello_schema::write(dw, hello);
+        dw.send();
     }
 
     // Funkcja wysyłająca komunikat accepted_player do klienta.
     // - player - komunikat do przesłania
     // - dw - writer do klienta
-    void send_accepted_player(accepted_player_t &player, DatagramWriter &dw) {
+    void send_accepted_player(accepted_player_t &player, BufferWriter &dw) {
         dw.clear();
-        dw.write(SC_ACCEPTED_PLAYER)
-                ->write(player.id)
-                ->write(player.player)
-                ->send();
+        accepted_player_schema::write(dw, player);
+        dw.send();
     }
 
     // Funkcja wysyłająca komunikat game_started do klienta.
     // - players - lista graczy biorących udział w grze
     // - dw - writer do klienta
-    void send_game_started(player_map_t &players , DatagramWriter &dw) {
+    void send_game_started(player_map_t &players , BufferWriter &dw) {
         dw.clear();
         dw.write(SC_GAME_STARTED)
                 ->write(players)
@@ -295,34 +415,93 @@ namespace {
     // Funkcja wysyłająca komunikat turn do klienta.
     // - turn - komunikat do przesłania
     // - dw - writer do klienta
-    void send_turn(game_turn_t &turn, DatagramWriter &dw) {
+    void send_turn(game_turn_t &turn, BufferWriter &dw) {
+        const auto &records = turn.events.records();
         dw.clear();
-        dw.write(SC_TURN)
-                ->write(turn.turn)
-                ->write(static_cast<container_size_t>(turn.events.size()));
-        for (auto &event : turn.events) {
-            visit(Overload {
-                    [&](bomb_placed_t &e) {
-                        dw.write(BOMB_PLACED)
-                                ->write(e.bomb_id)
-                                ->write(e.position);
-                    },
-                    [&](bomb_exploded_t &e) {
-                        dw.write(BOMB_EXPLODED)
-                                ->write(e.bomb_id)
-                                ->write(e.robots_destroyed)
-                                ->write(e.blocks_destroyed);
-                    },
-                    [&](player_moved_t &e) {
-                        dw.write(PLAYER_MOVED)
-                                ->write(e.player_id)
-                                ->write(e.position);
-                    },
-                    [&](block_placed_t &e) {
-                        dw.write(BLOCK_PLACED)
-                                ->write(e.position);
-                    }
-            }, event);
+        turn_header_schema::write(dw, {turn.turn, static_cast<container_size_t>(
+                records.size())});
+        for (const auto &e: records) {
+            switch (e.type) {
+                case BOMB_PLACED:
+                    bomb_placed_schema::write(dw, {e.id, e.position});
+                    break;
+                case BOMB_EXPLODED: {
+                    auto robots = turn.events.robots_of(e);
+                    auto blocks = turn.events.blocks_of(e);
+                    dw.write(e.type)
+                            ->write(e.id)
+                            ->write(static_cast<container_size_t>(robots.size()));
+                    for (const auto robot: robots)
+                        dw.write(robot);
+                    dw.write(static_cast<container_size_t>(blocks.size()));
+                    for (const auto &block: blocks)
+                        dw.write(block);
+                    break;
+                }
+                case PLAYER_MOVED:
+                    player_moved_schema::write(
+                            dw, {static_cast<player_num_t>(e.id), e.position});
+                    break;
+                case BLOCK_PLACED:
+                    block_placed_schema::write(dw, {e.position});
+                    break;
+            }
+        }
+        dw.send();
+    }
+
+    // Funkcja wyznaczająca największy możliwy rozmiar zakodowanego
+    // komunikatu turn. Każdy gracz generuje w turze co najwyżej jedno
+    // zdarzenie, a wybuchają tylko bomby postawione w jednej turze, czyli
+    // co najwyżej jedna na gracza. Wybuch niszczy najwyżej cztery bloki,
+    // po jednym na końcu każdego ramienia, i co najwyżej wszystkie roboty.
+    // - players - liczba graczy
+    size_t max_turn_size(const player_num_t players) {
+        const size_t header = sizeof(message_id_t) + sizeof(turn_t)
+                              + sizeof(container_size_t);
+        const size_t action = sizeof(message_id_t) + sizeof(bomb_id_t)
+                              + 2 * sizeof(coords_t);
+        const size_t explosion = sizeof(message_id_t) + sizeof(bomb_id_t)
+                                 + 2 * sizeof(container_size_t)
+                                 + players * sizeof(player_num_t)
+                                 + 4 * 2 * sizeof(coords_t);
+        return header + players * (action + explosion);
+    }
+
+    // Funkcja wysyłająca migawkę stanu gry do klienta. Migawka jest wysyłana
+    // jako komunikat turn, którego zdarzenia odtwarzają pozycje graczy, bloki
+    // i bomby, oraz komunikat game_state z wynikami graczy i licznikami bomb,
+    // których komunikat turn nie przenosi.
+    // - snapshot - migawka do przesłania
+    // - dw - writer do klienta
+    void send_snapshot(game_snapshot_t &snapshot, BufferWriter &dw) {
+        dw.clear();
+        turn_header_schema::write(dw, {snapshot.turn,
+                static_cast<container_size_t>(snapshot.positions.size()
+                        + snapshot.blocks.size() + snapshot.bombs.size())});
+        for (size_t i = 0; i < snapshot.positions.size(); i++) {
+            player_moved_schema::write(dw, {static_cast<player_num_t>(i),
+                                            snapshot.positions[i]});
+        }
+        for (const auto &block: snapshot.blocks) {
+            block_placed_schema::write(dw, {block});
+        }
+        for (const auto &bomb: snapshot.bombs) {
+            bomb_placed_schema::write(dw, {bomb.bomb_id, bomb.bomb.position});
+        }
+        dw.send();
+
+        dw.clear();
+        dw.write(SC_GAME_STATE)
+                ->write(static_cast<container_size_t>(snapshot.scores.size()));
+        for (size_t i = 0; i < snapshot.scores.size(); i++) {
+            dw.write(static_cast<player_num_t>(i))
+                    ->write(snapshot.scores[i]);
+        }
+        dw.write(static_cast<container_size_t>(snapshot.bombs.size()));
+        for (const auto &bomb: snapshot.bombs) {
+            dw.write(bomb.bomb_id)
+                    ->write(bomb.bomb.timer);
         }
         dw.send();
     }
@@ -330,101 +509,455 @@ namespace {
     // Funkcja wysyłająca komunikat game_ended do klienta.
     // - scores - wyniki graczy po zakończonej grze
     // - dw - writer do klienta
-    void send_game_ended(scores_t &scores , DatagramWriter &dw) {
+    void send_game_ended(scores_t &scores , BufferWriter &dw) {
         dw.clear();
         dw.write(SC_GAME_ENDED)
                 ->write(scores)
                 ->send();
     }
 
-    // Funkcja wysyłająca komunikaty do klienta.
-    // - dw - writer do klienta
-    // - server_queue - kolejka na której nasłuchuje dany serwer.
-    void send_to_client(DatagramWriter &dw, server_queue_t &server_queue) {
-        while (true) {
-            server_message_t m = server_queue.pop();
-            switch (m.id) {
-                case SC_HELLO:
-                    send_hello(get<hello_t>(m.data), dw);
-                    break;
-                case SC_ACCEPTED_PLAYER:
-                    send_accepted_player(get<accepted_player_t>(m.data), dw);
-                    break;
-                case SC_GAME_STARTED:
-                    send_game_started(get<player_map_t>(m.data), dw);
-                    break;
-                case SC_TURN:
-                    send_turn(get<game_turn_t>(m.data), dw);
-                    break;
-                case SC_GAME_ENDED:
-                    send_game_ended(get<scores_t>(m.data), dw);
-                    break;
+    // Funkcja kodująca komunikat do klienta do postaci wysyłanej przez sieć.
+    // - id - rodzaj komunikatu
+    // - sender - funkcja zapisująca komunikat do writera, np. send_turn
+    // - message - komunikat do zakodowania
+    // return - zakodowany komunikat
+    template<class T>
+    server_message_t encode(const message_id_t id,
+                            void (*sender)(T&, BufferWriter&), T &message) {
+        thread_local BufferHandler handler;
+        thread_local BufferWriter dw(&handler);
+        sender(message, dw);
+        auto res = make_shared<flex_buf_t>(handler.buffer());
+        handler.buffer().clear();
+        return {id, move(res)};
+    }
+
+    // Klasa przedstawiająca kanał, którym game master przekazuje komunikaty
+    // sesji klienta. Po wrzuceniu komunikatu budzi podłączoną sesję.
+    // Kanał mieści CHANNEL_CAPACITY komunikatów. Komunikat, który się nie
+    // zmieścił, jest odrzucany, a sesja zostaje wyrzucona. Klient nie może
+    // więc zająć dowolnie dużo pamięci.
+    // Kanał liczy też tury, które czekają na wysłanie do klienta, żeby game
+    // master mógł wykryć klienta, który nie nadąża za grą.
+    class ClientChannel {
+    private:
+        server_queue_t queue{CHANNEL_CAPACITY, OverflowPolicy::REJECT};
+        std::atomic<bool> evicted{false};
+        // Liczba tur w kanale i w trakcie wysyłania.
+        std::atomic<int64_t> pending_turns{0};
+        // Liczba tur wysłanych od podłączenia sesji.
+        std::atomic<uint64_t> written_turns{0};
+        // Kod ostatniej akcji gracza, zapisywany tylko przez sesję i zabierany
+        // przez game mastera w turze.
+        std::atomic<uint8_t> pending_action{NO_ACTION};
+        boost::mutex mutex;
+
+        static constexpr uint8_t NO_ACTION = 0;
+        static constexpr uint8_t ACTION_PLACE_BOMB = 1;
+        static constexpr uint8_t ACTION_PLACE_BLOCK = 2;
+        // Ruch w kierunku d ma kod ACTION_MOVE + d.
+        static constexpr uint8_t ACTION_MOVE = 3;
+
+        static uint8_t encode_action(const player_action_t &act) {
+            return visit(Overload {
+                [](const PlayerAction &action) {
+                    return action == PLACE_BOMB ? ACTION_PLACE_BOMB
+                                                : ACTION_PLACE_BLOCK;
+                },
+                [](const move_t &move) {
+                    return static_cast<uint8_t>(ACTION_MOVE + move.direction);
+                }
+            }, act);
+        }
+        // Funkcja budząca sesję podłączoną do kanału.
+        function<void()> waker;
+    public:
+        // Liczba tur wysłanych w chwili ostatniej resynchronizacji klienta.
+        // Używana tylko przez game mastera.
+        optional<uint64_t> resync_mark;
+
+        void push(const server_message_t &m) {
+            push(server_message_t(m));
+        }
+
+        void push(server_message_t &&m) {
+            bool turn = m.id == SC_TURN;
+            if (turn)
+                pending_turns++;
+            if (!queue.push(move(m))) {
+                if (turn)
+                    pending_turns--;
+                evicted = true;
+            }
+            wake();
+        }
+
+        optional<server_message_t> try_pop() {
+            return queue.try_pop();
+        }
+
+        // Metoda zapisująca ostatnią akcję gracza. Wywołuje ją tylko sesja,
+        // bez mutexa game mastera.
+        void set_action(const player_action_t &act) {
+            pending_action.store(encode_action(act), std::memory_order_release);
+        }
+
+        // Metoda zabierająca ostatnią akcję gracza, wywoływana w turze.
+        // return - akcja lub nullopt, jeżeli gracz nic nie zrobił
+        optional<player_action_t> take_action() {
+            uint8_t code = pending_action.exchange(NO_ACTION,
+                                                   std::memory_order_acq_rel);
+            switch (code) {
+                case NO_ACTION:
+                    return nullopt;
+                case ACTION_PLACE_BOMB:
+                    return PLACE_BOMB;
+                case ACTION_PLACE_BLOCK:
+                    return PLACE_BLOCK;
                 default:
+                    move_t move;
+                    move.direction = static_cast<Direction>(code - ACTION_MOVE);
+                    return move;
+            }
+        }
+
+        // Metoda wywoływana przez sesję, gdy skończy obsługiwać komunikat.
+        // - m - obsłużony komunikat
+        // - written - czy komunikat został wysłany do klienta
+        void done(const server_message_t &m, const bool written) {
+            if (m.id != SC_TURN)
+                return;
+            pending_turns--;
+            if (written)
+                written_turns++;
+        }
+
+        // Metoda zwracająca liczbę tur, o które klient jest opóźniony.
+        int64_t lag() const {
+            return pending_turns;
+        }
+
+        uint64_t written() const {
+            return written_turns;
+        }
+
+        // Metoda każąca sesji zakończyć połączenie.
+        void evict() {
+            evicted = true;
+            wake();
+        }
+
+        // Metoda sprawdzająca, czy sesja ma zakończyć połączenie.
+        bool is_evicted() const {
+            return evicted;
+        }
+
+        // Metoda usuwająca z kanału tury czekające na wysłanie. Pozostałe
+        // komunikaty, np. game_started, zostają w kanale w tej samej
+        // kolejności.
+        void drop_turns() {
+            queue.erase_if([this](const server_message_t &m) {
+                if (m.id != SC_TURN)
+                    return false;
+                done(m, false);
+                return true;
+            });
+        }
+
+        // Metoda sprawdzająca, czy do kanału jest podłączona sesja.
+        bool is_attached() {
+            boost::lock_guard<boost::mutex> guard(mutex);
+            return static_cast<bool>(waker);
+        }
+
+        // Metoda budząca sesję podłączoną do kanału.
+        void wake() {
+            function<void()> w;
+            {
+                boost::lock_guard<boost::mutex> guard(mutex);
+                w = waker;
+            }
+            if (w) w();
+        }
+
+        // Metoda podłączająca sesję do kanału.
+        // - w - funkcja budząca sesję
+        void attach(function<void()> w) {
+            boost::lock_guard<boost::mutex> guard(mutex);
+            waker = move(w);
+        }
+
+        // Metoda odłączająca sesję od kanału.
+        void detach() {
+            boost::lock_guard<boost::mutex> guard(mutex);
+            waker = nullptr;
+        }
+    };
+
+    // Klasa obsługująca asynchronicznie połączenie z jednym klientem.
+    // Gniazdo sesji ma własny strand, więc wszystkie jej metody wykonują się
+    // sekwencyjnie i nie wymagają dodatkowej synchronizacji.
+    class ClientSession : public std::enable_shared_from_this<ClientSession> {
+    private:
+        tcp::socket socket;
+        gm_queue_t &game_master_queue;
+        const shared_ptr<ClientChannel> channel;
+        const server_id_t id;
+        name_t client_address;
+        array<char, READ_BUFFER_SIZE> read_buf;
+        // Odebrane bajty, które nie tworzą jeszcze całego komunikatu.
+        flex_buf_t input;
+        // Aktualnie wysyłane komunikaty i ich bufory.
+        vector<server_message_t> output;
+        vector<as::const_buffer> output_buffers;
+        bool writing;
+        bool corked;
+        bool closed;
+
+        void push_to_game_master(client_message_t &&message) {
+            game_master_message_t gm_mess;
+            gm_mess.server_id = id;
+            gm_mess.message = move(message);
+            game_master_queue.push(move(gm_mess));
+        }
+
+        void do_read() {
+            socket.async_read_some(as::buffer(read_buf),
+                [this, self = shared_from_this()]
+                (const boost::system::error_code &err, size_t bytes) {
+                    if (err) {
+                        close();
+                        return;
+                    }
+                    input.insert(input.end(), read_buf.begin(),
+                                 read_buf.begin() + bytes);
+                    drain_socket();
+                    // Akcje graczy nie przechodzą przez kolejkę game mastera.
+                    // Z akcji odebranych w jednej porcji liczy się tylko
+                    // ostatnia, która trafia do kanału sesji.
+                    size_t parsed = 0;
+                    optional<player_action_t> action;
+                    try {
+                        size_t consumed;
+                        while (auto m = parse_client_message(
+                                input.data() + parsed, input.size() - parsed,
+                                client_address, consumed)) {
+                            parsed += consumed;
+                            if (auto act = get_if<player_action_t>(&*m))
+                                action = *act;
+                            else
+                                push_to_game_master(
+                                        get<server_join_t>(move(*m)));
+                        }
+                        if (action)
+                            channel->set_action(*action);
+                    }
+                    catch (exception &err) {
+                        close();
+                        return;
+                    }
+                    input.erase(input.begin(),
+                                input.begin() + static_cast<long>(parsed));
+                    do_read();
+                });
+        }
+
+        // Metoda dopisująca do input bajty, które już czekają w gnieździe,
+        // ale nie więcej niż MAX_DRAIN_READS buforów, żeby klient zasypujący
+        // serwer danymi nie zajmował wątku sesji bez końca. Resztę odbierze
+        // kolejny odczyt asynchroniczny. Odczyt nie blokuje, bo nie
+        // przekracza available().
+        void drain_socket() {
+            boost::system::error_code err;
+            size_t available = socket.available(err);
+            for (size_t reads = 0;
+                 !err && available > 0 && reads < MAX_DRAIN_READS; reads++) {
+                size_t bytes = socket.read_some(as::buffer(
+                        read_buf, std::min(available, read_buf.size())), err);
+                input.insert(input.end(), read_buf.begin(),
+                             read_buf.begin() + static_cast<long>(bytes));
+                available = socket.available(err);
+            }
+        }
+
+        void do_write() {
+            if (closed) return;
+            if (channel->is_evicted()) {
+                close();
+                return;
+            }
+            if (writing) return;
+            // Wszystkie komunikaty czekające w kanale (np. tury nadrabiane
+            // przez spóźnionego klienta) są wysyłane jednym zapisem
+            // rozproszonym, a nie osobnym wywołaniem systemowym każdy.
+            output.clear();
+            output_buffers.clear();
+            while (output.size() < MAX_WRITE_BATCH) {
+                auto m = channel->try_pop();
+                if (!m) break;
+                if (!m->data) {
+                    channel->done(*m, false);
                     continue;
+                }
+                output_buffers.push_back(as::buffer(*m->data));
+                output.push_back(move(*m));
             }
+            if (output.empty()) return;
+
+            // Zapis, który wymaga kilku wywołań sendmsg, jest wysyłany przy
+            // zatkanym gnieździe, żeby jądro nie wysyłało niepełnych
+            // segmentów między wywołaniami.
+            if (output.size() > CORK_THRESHOLD)
+                set_cork(true);
+            writing = true;
+            as::async_write(socket, output_buffers,
+                [this, self = shared_from_this()]
+                (const boost::system::error_code &err, size_t) {
+                    writing = false;
+                    if (corked)
+                        set_cork(false);
+                    for (const auto &m: output)
+                        channel->done(m, !err);
+                    output.clear();
+                    if (err) {
+                        close();
+                        return;
+                    }
+                    do_write();
+                });
         }
-    }
 
-    // Funkcja obsługująca moment, gdy nowy klient jest podłączany
-    // do serwera. Przekazuje informację game masterowi,, że pojawił się nowy
-    // klient i czyści stare komunikaty z kolejki.
-    // - gq - kolejka na której  nasłuchuje game master
-    // - sq - kolejka mna której nasłuchuje dany wątek
-    // - id - id serwera dla którego została wywołana funkcja
-    void client_connect(gm_queue_t &gq, server_queue_t &sq,
-                        const server_id_t id) {
-        game_master_message_t reset_message;
-        reset_message.server_id = id;
-        reset_message.message = RESET_SERVER;
-        // Przesyłany jest komunikat RESET_SERVER, a następnie jest oczekiwanie
-        // na potwierdzenie od serwera w postaci tego samego komunikatu.
-        gq.push(reset_message);
-        while (true) {
-            server_message_t m = sq.pop();
-            if (m.id != RESET_SERVER)
-                continue;
-            break;
+        // Metoda zatykająca gniazdo (TCP_CORK) albo je odtykająca, co wysyła
+        // zebrane dane. Na systemach bez TCP_CORK nic nie robi.
+        void set_cork(const bool cork) {
+#ifdef TCP_CORK
+            using tcp_cork = as::detail::socket_option::boolean<
+                    IPPROTO_TCP, TCP_CORK>;
+            boost::system::error_code ignored;
+            socket.set_option(tcp_cork(cork), ignored);
+            corked = cork;
+#else
+            (void) cork;
+#endif
         }
-    }
+
+        void close() {
+            if (closed) return;
+            closed = true;
+            channel->detach();
+            boost::system::error_code ignored;
+            socket.close(ignored);
+            push_to_game_master(client_message_t{
+                std::in_place_type<simple_message_t>, SESSION_CLOSED});
+        }
+
+    public:
+        ClientSession(tcp::socket &&_socket, gm_queue_t &gq,
+                      const server_id_t _id) :
+                socket(move(_socket)), game_master_queue(gq),
+                channel(make_shared<ClientChannel>()), id(_id),
+                writing(false), corked(false), closed(false) {}
+
+        // Metoda rozpoczynająca obsługę klienta. Przekazuje game masterowi
+        // kanał nowego klienta.
+        void start() {
+            try {
+                socket.set_option(tcp::no_delay(true));
+                std::ostringstream address;
+                address << socket.remote_endpoint();
+                client_address = string_to_name(address.str());
+            }
+            catch (exception &err) {
+                return;
+            }
+
+            channel->attach([weak = weak_from_this(),
+                            executor = socket.get_executor()]() {
+                as::post(executor, [weak]() {
+                    if (auto self = weak.lock())
+                        self->do_write();
+                });
+            });
+            push_to_game_master(session_opened_t{channel});
+            do_read();
+        }
+    };
+
+    // Klasa przyjmująca asynchronicznie połączenia od klientów i tworząca
+    // dla nich sesje.
+    class Server {
+    private:
+        as::io_context &io_context;
+        tcp::acceptor acceptor;
+        gm_queue_t &game_master_queue;
+        server_id_t next_id; // Id kolejnej sesji.
+
+        void do_accept() {
+            acceptor.async_accept(as::make_strand(io_context),
+                [this](const boost::system::error_code &err,
+                       tcp::socket socket) {
+                    if (!err) {
+                        make_shared<ClientSession>(
+                                move(socket), game_master_queue,
+                                next_id++)->start();
+                    }
+                    do_accept();
+                });
+        }
+
+    public:
+        Server(as::io_context &_io_context, const port_t port,
+               gm_queue_t &gq) :
+                io_context(_io_context),
+                acceptor(as::make_strand(io_context),
+                         tcp::endpoint(tcp::v6(), port)),
+                game_master_queue(gq), next_id(0) {}
+
+        void start() {
+            do_accept();
+        }
+    };
 
     // Klasa przedstawiająca gracza,, czyli klienta który wysłał pomyślnie
     // komunikat join.
+    // Pozycję i wynik gracza przechowuje silnik gry.
     class Player {
     private:
-        position_t position; // Pozycja gracza.
         accepted_player_t player_info;
-        score_t score;
-        // Akcja jaką wykonał gracz w tej turze.
-        optional<player_action_t> action;
+        // Kanał sesji gracza, do którego sesja zapisuje jego akcje.
+        shared_ptr<ClientChannel> channel;
 
     public:
-        Player(accepted_player_t &player) :
-                player_info(player), score(0), action(nullopt) {}
+        Player(accepted_player_t &player, shared_ptr<ClientChannel> _channel) :
+                player_info(player), channel(move(_channel)) {}
 
         accepted_player_t get_player_info() const { return player_info; }
-        position_t get_position() const { return position; }
-        optional<player_action_t> get_action() const { return action; }
-        score_t get_score() const { return score; }
-
-        void set_position(const position_t p) {
-            position = p;
-        }
 
-        void set_action(const optional<player_action_t> act) {
-            action = act;
-        }
-
-        void inc_score() {
-            score++;
+        // Metoda zabierająca akcję, którą gracz wykonał w tej turze.
+        optional<player_action_t> take_action() {
+            return channel->take_action();
         }
     };
 
     // Klasa opisująca game mastera, czyli klasę, której obiekt zarządza
     // całą grą.
+    // Tury są obsługiwane potokiem dwóch etapów. Etap liczenia (make_turn)
+    // działa pod mutexem stanu gry i wstawia wynik tury do bufora
+    // cyklicznego publications. Etap rozsyłania (publish_pending) jest
+    // osobnym zadaniem schedulera: koduje tury, zapisuje je w historii i
+    // rozsyła do sesji pod publish_mutex. Rozsyłanie tury nakłada się więc na
+    // oczekiwanie na kolejną turę, a obsługa komunikatów od klientów nie
+    // czeka na rozsyłanie. Jeżeli potrzebne są oba mutexy, publish_mutex
+    // jest zajmowany jako drugi. Komunikaty do wszystkich sesji również
+    // przechodzą przez bufor, żeby zachować kolejność względem tur.
     class GameMaster {
     private:
         boost::mutex mutex;
-        boost::condition_variable for_game;
+        boost::mutex publish_mutex;
+        // Funkcja wyznaczająca termin kolejnej tury w schedulerze.
+        const function<void(TickScheduler::clock::time_point)> schedule_turn;
+        // Funkcja uruchamiająca etap rozsyłania.
+        const function<void()> wake_publisher;
 
         // Ustawienia gry.
         const game_time_t bomb_timer;
@@ -433,158 +966,127 @@ namespace {
         const explosion_radius_t explosion_radius;
         const block_count_t initial_blocks;
         const game_time_t game_length;
+        const turn_t max_lag;
+        const SlowClientPolicy slow_client_policy;
+        // Czy wypisywać statystyki gry po jej zakończeniu.
+        const bool verbose;
         name_t server_name;
         const coords_t x;
         const coords_t y;
-        mutable minstd_rand random;
+
+        // Obiekty chronione przez publish_mutex.
+        // Komunikat resync, poprzedzający migawkę dla opóźnionego klienta.
+        const server_message_t resync{
+                SC_RESYNC, make_shared<const flex_buf_t>(
+                        1, static_cast<char>(SC_RESYNC))};
+        // Zakodowany komunikat game_started bieżącej gry.
+        wire_message_t game_started;
+        // Komunikaty accepted_player rozesłane w bieżącym lobby.
+        vector<server_message_t> accepted_players;
+        // Ostatnia migawka stanu gry i tury rozegrane po niej.
+        TurnHistory game_turns;
+        // Kanały podłączonych sesji.
+        unordered_map<server_id_t, shared_ptr<ClientChannel>> sessions;
+        // Czy historia przekroczyła limit pamięci i po kolejnej turze
+        // należy zapisać migawkę.
+        std::atomic<bool> keyframe_due{false};
+        // Czy etap rozsyłania został uruchomiony i jeszcze nie zaczął
+        // opróżniać bufora.
+        std::atomic<bool> publisher_woken{false};
 
         // Obiekty wykorzystywane przy zarządzaniu stanem.
         GameState game_state;
-        vector<game_turn_t> game_turns;
         unordered_map<server_id_t, player_num_t> playing_servers;
         vector<Player> players;
-        position_set blocks;
-        unordered_map<bomb_id_t, bomb_t> bombs;
-        bomb_id_t bomb_count;
-        turn_t current_turn;
-
-        // Metoda sprawdzająca, czy dane współrzędne mogą się
-        // znajdować na planszy.
-        // - position - współrzędne sprawdzanego pola.
-        // return - wartość prawda/fałsz, czy podano prawidłowe współrzędne
-        bool is_position_valid(const position_t position) const {
-            return position.x < x && position.y < y;
-        }
-
-        // Metoda znajdująca wszystkie pola narażone na eksplozję bomby w danym
-        // kierunku.
-        // - scanner - pole na którym jest bomba (nie jest ono sprawdzane)
-        // - shifter - funkcja przesuwająca skaner na odpowiednie miejsce
-        // - explosions - struktura na którą są wrzucane zniszczone pola.
-        void handle_explosion_stripe(position_t scanner,
-                                     const function<void(position_t&)> &shifter,
-                                     position_set &explosions) const {
-            for (explosion_radius_t i = 0;
-                 i < explosion_radius; i++) {
-                shifter(scanner);
-                if (!is_position_valid(scanner)) break;
-                explosions.insert(scanner);
-                if (blocks.contains(scanner)) break;
-            }
-        }
-
-        // Metoda znajdująca wszystkie pola narażone na eksplozję danej bomby.
-        // - bomb_position - miejsce w którym znajduje się bomba.
-        // return - zniszczone pola
-        position_set handle_explosions(const position_t &bomb_position) const {
-            position_set explosions;
-            explosions.insert(bomb_position);
-            if (!blocks.contains(bomb_position)) {
-                handle_explosion_stripe(bomb_position,
-                                        [](position_t &p){p.x++;}, explosions);
-                handle_explosion_stripe(bomb_position,
-                                        [](position_t &p){p.x--;}, explosions);
-                handle_explosion_stripe(bomb_position,
-                                        [](position_t &p){p.y++;}, explosions);
-                handle_explosion_stripe(bomb_position,
-                                        [](position_t &p){p.y--;}, explosions);
-            }
-
-            return explosions;
-        }
-
-        // Metoda zwracająca komunikat hello na podstawie informacji o serwerze.
+        // Zasady gry i stan planszy.
+        GameEngine engine;
+        // Akcje graczy w bieżącej turze. Bufor jest używany ponownie.
+        vector<optional<player_action_t>> actions;
+        // Termin, w którym należy rozegrać kolejną turę.
+        TickScheduler::clock::time_point next_deadline;
+        // Liczba tur bieżącej gry, których nie zdążono rozegrać w terminie.
+        uint64_t missed_deadlines;
+
+        // Porcja komunikatów przekazywana etapowi rozsyłania. Komunikaty są
+        // rozsyłane w kolejności pól.
+        struct publication_t {
+            // Komunikat game_started, jeżeli porcja rozpoczyna grę.
+            optional<server_message_t> game_started;
+            bool has_turn;
+            // Zdarzenia tury. Bufor jest używany ponownie w kolejnych turach.
+            game_turn_t turn;
+            // Migawka stanu po turze, jeżeli ma zastąpić historię.
+            optional<game_snapshot_t> keyframe;
+            // Komunikat accepted_player o graczu przyjętym do lobby.
+            optional<server_message_t> accepted_player;
+            // Komunikat game_ended, jeżeli porcja kończy grę.
+            optional<server_message_t> game_ended;
+        };
+        SPSCRing<publication_t, PUBLICATION_QUEUE_SIZE> publications;
+
+        // Metoda zwracająca zakodowany komunikat hello na podstawie informacji
+        // o serwerze.
         // return - hello
-        hello_t create_hello() const {
-            return {server_name, players_count, x, y, game_length,
-                    explosion_radius, bomb_timer};
+        server_message_t create_hello() const {
+            hello_t hello{server_name, players_count, x, y, game_length,
+                          explosion_radius, bomb_timer};
+            return encode(SC_HELLO, send_hello, hello);
         }
 
-        // Metoda zwracająca komunikat game_started.
+        // Metoda zwracająca zakodowany komunikat game_started.
         // return - game_started
         server_message_t create_game_started() const {
-            server_message_t game_started{SC_GAME_STARTED, nullptr};
             player_map_t join_players;
             for (size_t i = 0; i < players.size(); i++) {
                 join_players[static_cast<player_num_t>(i)]
                     = players[i].get_player_info().player;
             }
-            game_started.data = join_players;
-            return game_started;
+            return encode(SC_GAME_STARTED, send_game_started, join_players);
         }
 
-        // Metoda resetująca serwer, czyli odłączająca go od gracza,
-        // jeżeli ten wysłał komunikat join, a następnie przesyłająca
-        // nowe komunikaty dla nowego klienta.
-        // - server_id - id serwera do zresetowania
-        // - server_q - kolejka serwera o id server_id
-        void reset_server(const server_id_t server_id,
-                          server_queue_t &server_q) {
-            server_message_t reset_message = {RESET_SERVER, nullptr};
-
-            playing_servers.erase(server_id);
-
-            server_q.push(reset_message);
-            server_message_t hello_message{SC_HELLO, create_hello()};
-            server_q.push(hello_message);
-            if (game_state == LOBBY) {
-                for (auto &player: players) {
-                    server_message_t accepted_player_m
-                        {SC_ACCEPTED_PLAYER,
-                        player.get_player_info()};
-                    server_q.push(accepted_player_m);
-                }
+        // Metoda rejestrująca sesję nowego klienta i przesyłająca mu
+        // komunikaty opisujące aktualny stan serwera.
+        // - server_id - id sesji
+        // - channel - kanał sesji
+        void open_session(const server_id_t server_id,
+                          const shared_ptr<ClientChannel> &channel) {
+            boost::lock_guard<boost::mutex> guard(publish_mutex);
+            sessions[server_id] = channel;
+            ClientChannel &server_q = *channel;
+            server_q.push(create_hello());
+            // Sesja dostaje stan z punktu widzenia etapu rozsyłania, a
+            // komunikaty czekające w buforze dostanie razem z innymi.
+            if (!game_started) {
+                for (const auto &accepted: accepted_players)
+                    server_q.push(accepted);
             }
             else {
-                server_message_t game_started = create_game_started();
-                for (const auto &game_turn: game_turns) {
-                    server_message_t game_turn_m{SC_TURN, game_turn};
-                    server_q.push(game_turn_m);
-                }
-            }
-        }
-
-        // Metoda sprawdzająca, czy server_id obsługuje grającego klienta
-        // - server_id - id serwera do sprawdzenia
-        // return - true/false
-        bool is_playing(const server_id_t server_id) const {
-            return game_state == GAME && playing_servers.contains(server_id);
-        }
-
-        // Metoda obsługująca komunikat CS_PLACE_BOMB.
-        // - server_id - id serwera, który odebrał komunikat.
-        void handle_place_bomb(const server_id_t server_id) {
-            if (is_playing(server_id)) {
-                players.at(playing_servers[server_id])
-                        .set_action(PlayerAction::PLACE_BOMB);
+                server_q.push({SC_GAME_STARTED, game_started});
+                server_q.push({SC_TURN, make_shared<flex_buf_t>(
+                        game_turns.contents())});
             }
         }
 
-        // Metoda obsługująca komunikat CS_PLACE_BLOCK.
-        // - server_id - id serwera, który odebrał komunikat.
-        void handle_place_block(const server_id_t server_id) {
-            if (is_playing(server_id)) {
-                players.at(playing_servers[server_id])
-                        .set_action(PlayerAction::PLACE_BLOCK);
-            }
+        // Metoda wyrejestrowująca sesję zamkniętego połączenia.
+        // - server_id - id sesji
+        void close_session(const server_id_t server_id) {
+            playing_servers.erase(server_id);
+            boost::lock_guard<boost::mutex> guard(publish_mutex);
+            sessions.erase(server_id);
         }
 
-        // Metoda obsługująca komunikat CS_MOVE.
-        // - server_id - id serwera, który odebrał komunikat
-        // - move_t - komunikat odebrany od klienta
-        void handle_move(const server_id_t server_id, const move_t &move) {
-            if (is_playing(server_id)) {
-                players.at(playing_servers[server_id])
-                        .set_action(move);
-            }
+        // Metoda rozsyłająca komunikat do wszystkich podłączonych sesji.
+        // Wymaga zajętego publish_mutex.
+        // - m - komunikat do rozesłania
+        void broadcast(const server_message_t &m) {
+            for (auto &session: sessions)
+                session.second->push(m);
         }
 
         // Metoda obsługująca komunikat CS_JOIN.
-        // - queues - lista kolejek na których nasłuchują serwery
         // - join - komunikat odebrany od klienta
         // - id - id serwera, który odebrał komunikat
-        void handle_join(server_queue_list_t &queues,
-                         const server_join_t &join, const server_id_t id) {
+        void handle_join(const server_join_t &join, const server_id_t id) {
             if (game_state == LOBBY && !playing_servers.contains(id)) {
                 player_t player;
                 player.name = join.join.name;
@@ -592,357 +1094,425 @@ namespace {
                 playing_servers[id] = static_cast<player_num_t>(players.size());
                 accepted_player_t accepted_player{
                         static_cast<player_num_t>(players.size()), player};
-                players.emplace_back(accepted_player);
-
-                server_message_t sm{SC_ACCEPTED_PLAYER, accepted_player};
-                for (auto &queue: queues)
-                    queue.push(sm);
+                {
+                    // Rejestr sesji jest chroniony przez publish_mutex.
+                    boost::lock_guard<boost::mutex> guard(publish_mutex);
+                    players.emplace_back(accepted_player, sessions.at(id));
+                }
+                publication_t &p = claim_publication();
+                p.accepted_player = encode(SC_ACCEPTED_PLAYER,
+                                           send_accepted_player,
+                                           accepted_player);
+                commit_publication();
 
                 if (players.size() == players_count) {
-                    start_game(queues);
+                    start_game();
                 }
             }
         }
 
-        // Metoda obsługująca ruchy klienta podczas gry.
-        // - id - id gracza, który wyykonał akcję.
-        // - act - akcja gracza
-        // - new_blocks - struktura na którą zostanie dodany blok, jeżeli
-        //                  akcja to PLACE_BLOCK
-        // - events - struktura na którą zostanie wrzucony event
-        void handle_player_action(const player_num_t id,
-                                  const player_action_t act,
-                              position_set &new_blocks, event_list_t &events) {
-            visit(Overload {
-                [&](const PlayerAction &action) {
-                    switch (action) {
-                        case PLACE_BLOCK:
-                            new_blocks.insert(players[id].get_position());
-                            events.push_back(
-                                    block_placed_t{players[id].get_position()});
-                            break;
-                        case PLACE_BOMB:
-                            events.push_back(
-                                    bomb_placed_t{bomb_count,
-                                                  players[id].get_position()});
-                            bombs[bomb_count++] = {players[id].get_position(),
-                                                   bomb_timer};
-                            break;
-                    }
-                },
-                [&](const move_t &move) {
-                    position_t np = players[id].get_position();
-                    switch (move.direction) {
-                        case UP:
-                            np = {np.x, static_cast<coords_t>(np.y + 1)};
-                            break;
-                        case RIGHT:
-                            np = {static_cast<coords_t>(np.x + 1), np.y};
-                            break;
-                        case DOWN:
-                            np = {np.x, static_cast<coords_t>(np.y - 1)};
-                            break;
-                        case LEFT:
-                            np = {static_cast<coords_t>(np.x - 1), np.y};
-                            break;
-                    }
-                    if (is_position_valid(np) && !blocks.contains(np)) {
-                        players[id].set_position(np);
-                        events.push_back(player_moved_t{id, np});
-                    }
-                }
-            }, act);
+        // Metoda zwracająca pustą porcję komunikatów w buforze. Jeżeli bufor
+        // jest pełny, bo rozsyłanie nie nadąża, zaległe porcje są rozsyłane
+        // w bieżącym wątku. Wymaga zajętego mutexa stanu gry.
+        publication_t &claim_publication() {
+            publication_t *p = publications.claim();
+            if (!p) {
+                boost::lock_guard<boost::mutex> guard(publish_mutex);
+                publish_all();
+                p = publications.claim();
+            }
+            p->game_started.reset();
+            p->has_turn = false;
+            p->keyframe.reset();
+            p->accepted_player.reset();
+            p->game_ended.reset();
+            return *p;
         }
 
-        position_t random_position() const {
-            return {static_cast<coords_t>(random() % x),
-                    static_cast<coords_t>(random() % y)};
+        // Metoda przekazująca porcję zwróconą przez claim_publication etapowi
+        // rozsyłania.
+        void commit_publication() {
+            publications.commit();
+            if (!publisher_woken.exchange(true))
+                wake_publisher();
         }
 
-        // Metoda rozsyłająca nową turę do wszystkich serwerów.
-        // - gt - aktualna tura
-        // - queues - kolejki na których nasłuchują serwery.
-        void send_next_turn(game_turn_t &gt, server_queue_list_t &queues) {
-            server_message_t game_turn_m{SC_TURN, gt};
-            for (auto &queue: queues)
-                queue.push(game_turn_m);
+        // Metoda zapisująca turę w porcji. Co KEYFRAME_INTERVAL tur, oraz po
+        // turze, w której historia przekroczyła limit pamięci, do porcji
+        // trafia migawka stanu gry. Wymaga zajętego mutexa stanu.
+        // - p - porcja, w której policzono turę
+        void add_turn(publication_t &p) {
+            p.has_turn = true;
+            if (p.turn.turn % KEYFRAME_INTERVAL == 0
+                || keyframe_due.exchange(false))
+                p.keyframe = engine.snapshot();
         }
 
-        // Metoda inicjująca grę, przesyłająca komunikat game_started do
-        // serwerów oraz zerową turę.
-        // - queues - kolejki na której nasłuchują serwery
-        void start_game(server_queue_list_t &queues) {
-            server_message_t game_started = create_game_started();
-            game_turn_t turn;
-            turn.turn = current_turn++;
-            for (size_t i = 0; i < players.size(); i++) {
-                position_t new_position = random_position();
-                players[i].set_position(new_position);
-                player_moved_t pm{static_cast<player_num_t>(i), new_position};
-                turn.events.push_back(pm);
+        // Metoda rozsyłająca wszystkie porcje czekające w buforze. Wymaga
+        // zajętego publish_mutex, ale nie mutexa stanu gry.
+        void publish_all() {
+            while (publication_t *p = publications.front()) {
+                publish(*p);
+                publications.pop();
+            }
+        }
+
+        // Metoda rozsyłająca porcję komunikatów do wszystkich serwerów i
+        // zapisująca turę w historii. Tura jest kodowana tylko raz, a
+        // wszystkie kolejki dostają wskaźnik na ten sam bufor.
+        // - p - porcja do rozesłania
+        void publish(publication_t &p) {
+            if (p.game_started) {
+                game_started = p.game_started->data;
+                accepted_players.clear();
+                broadcast(*p.game_started);
+            }
+
+            if (p.has_turn) {
+                server_message_t game_turn_m = encode(SC_TURN, send_turn,
+                                                      p.turn);
+                if (p.keyframe) {
+                    game_turns.set_keyframe(
+                            *encode(SC_TURN, send_snapshot, *p.keyframe).data);
+                }
+                else if (!game_turns.append(*game_turn_m.data)) {
+                    keyframe_due = true;
+                }
+
+                for (auto &session: sessions) {
+                    ClientChannel &channel = *session.second;
+                    channel.push(game_turn_m);
+                    if (channel.lag() > max_lag && channel.is_attached())
+                        handle_slow_client(channel);
+                }
             }
 
-            for (auto &queue: queues) {
-                queue.push(game_started);
+            if (p.accepted_player) {
+                accepted_players.push_back(*p.accepted_player);
+                broadcast(*p.accepted_player);
             }
 
-            for (block_count_t i = 0; i < initial_blocks; i++) {
-                position_t new_position = random_position();
-                if (blocks.contains(new_position)) continue;
-                blocks.insert(new_position);
-                block_placed_t bp{new_position};
-                turn.events.push_back(bp);
+            if (p.game_ended) {
+                broadcast(*p.game_ended);
+                game_started = nullptr;
+                game_turns.clear();
+                keyframe_due = false;
             }
+        }
+
+        // Metoda obsługująca klienta, który jest opóźniony o więcej niż
+        // max_lag tur. Klient jest rozłączany albo, jeżeli wybrano
+        // resynchronizację, dostaje zamiast zaległych tur komunikat
+        // resync, a po nim migawkę stanu gry i tury rozegrane po niej. Klient, który od poprzedniej
+        // resynchronizacji nie odebrał żadnej tury, nie jest resynchronizowany
+        // ponownie. Jeżeli całkiem przestał odbierać, zostanie rozłączony po
+        // przepełnieniu kanału.
+        // - channel - kanał opóźnionego klienta
+        void handle_slow_client(ClientChannel &channel) {
+            if (slow_client_policy == DISCONNECT) {
+                channel.evict();
+            }
+            else if (channel.resync_mark != channel.written()) {
+                channel.resync_mark = channel.written();
+                channel.drop_turns();
+                channel.push(resync);
+                channel.push({SC_TURN,
+                              make_shared<flex_buf_t>(game_turns.contents())});
+            }
+        }
+
+        // Metoda inicjująca grę, przesyłająca komunikat game_started do
+        // serwerów oraz zerową turę.
+        void start_game() {
+            publication_t &p = claim_publication();
+            p.game_started = create_game_started();
+            engine.start(static_cast<player_num_t>(players.size()), p.turn);
+
+            // Akcje wysłane przed rozpoczęciem gry są pomijane.
+            for (auto &player: players)
+                player.take_action();
 
             game_state = GAME;
-            send_next_turn(turn, queues);
-            game_turns.push_back(turn);
-            for_game.notify_one(); // Budzenie wątku wykonującego make_turn().
+            next_deadline = TickScheduler::clock::now()
+                            + boost::chrono::milliseconds(turn_duration);
+            missed_deadlines = 0;
+            add_turn(p);
+            commit_publication();
+            schedule_turn(next_deadline);
         }
 
         // Metoda czyszcząca stan po zakończonej grze.
         void clear_game_state() {
             game_state = LOBBY;
-            game_turns.clear();
             playing_servers.clear();
             players.clear();
-            blocks.clear();
-            bombs.clear();
-            bomb_count = 0;
-            current_turn = 0;
+            engine.clear();
         }
 
-        // Metoda wysyłająca punktacje po zakończonej grze i czyszcząca stan.
-        // - queues - kolejki na których nasłuchują serwery.
-        void end_game(server_queue_list_t &queues) {
+        // Metoda kończąca grę i czyszcząca stan.
+        // return - komunikat game_ended z punktacją, do rozesłania
+        server_message_t end_game() {
             scores_t scores;
-            for (size_t i = 0; i < players.size(); i++) {
-                scores[static_cast<player_num_t>(i)]
-                    = players[i].get_score();
-            }
-            server_message_t sm{SC_GAME_ENDED, scores};
-            for (auto &queue: queues) {
-                queue.push(sm);
+            const auto &engine_scores = engine.get_scores();
+            for (size_t i = 0; i < engine_scores.size(); i++)
+                scores[static_cast<player_num_t>(i)] = engine_scores[i];
+            if (verbose) {
+                cerr << "Missed " << missed_deadlines
+                     << " turn deadlines during the game." << endl;
             }
             clear_game_state();
+            return encode(SC_GAME_ENDED, send_game_ended, scores);
+        }
+
+        // Metoda obsługująca komunikat odebrany od serwera. Wymaga zajętego
+        // mutexa game mastera.
+        // - m - wiadomość od serwera
+        void handle_server_message(game_master_message_t &m) {
+            visit(Overload {
+                    [&](session_opened_t &so) {
+                        open_session(m.server_id, so.channel);
+                    },
+                    [&](server_join_t &join) {
+                        handle_join(join, m.server_id);
+                    },
+                    [&](simple_message_t &sm) {
+                        if (sm == SESSION_CLOSED)
+                            close_session(m.server_id);
+                    }
+            }, m.message);
         }
     public:
-        GameMaster(const command_parameters_t &cp) :
+        // Konstruktor game mastera.
+        // - cp - ustawienia gry
+        // - _schedule_turn - funkcja wyznaczająca termin wywołania make_turn
+        // - _wake_publisher - funkcja zlecająca wywołanie publish_pending
+        GameMaster(const command_parameters_t &cp,
+                   function<void(TickScheduler::clock::time_point)>
+                       _schedule_turn,
+                   function<void()> _wake_publisher) :
+                schedule_turn(std::move(_schedule_turn)),
+                wake_publisher(std::move(_wake_publisher)),
                 bomb_timer(cp.bomb_timer),
                 players_count(cp.players_count),
                 turn_duration(cp.turn_duration),
                 explosion_radius(cp.explosion_radius),
                 initial_blocks(cp.initial_blocks),
                 game_length(cp.game_length),
+                max_lag(cp.max_lag),
+                slow_client_policy(cp.slow_client_policy),
+                verbose(cp.verbose),
                 server_name(string_to_name(cp.server_name)),
                 x(cp.size_x),
                 y(cp.size_y),
-                random(cp.seed) {
+                // Po przekroczeniu limitu do historii trafiają jeszcze tury
+                // czekające w buforze publications, zanim dotrze migawka.
+                game_turns(cp.history_memory, PUBLICATION_QUEUE_SIZE
+                                              * max_turn_size(cp.players_count)),
+                engine({cp.size_x, cp.size_y, cp.game_length,
+                        cp.explosion_radius, cp.bomb_timer, cp.initial_blocks,
+                        cp.seed}),
+                missed_deadlines(0) {
             clear_game_state();
         }
 
-        // Metoda przeprowadzająca kolejną turę
-        // - server_queues - lista kolejek na której nasłuchują serwery.
-        void make_turn(server_queue_list_t &server_queues) {
-            {
-                boost::unique_lock<boost::mutex> lock(mutex);
-                while (game_state != GAME)
-                    for_game.wait(lock); // Czekanie na rozpoczęcie.
+        // Metoda przesuwająca termin kolejnej tury o turn_duration. Jeżeli
+        // rozegranie tury trwało tak długo, że kolejny termin już minął,
+        // spóźnione tury są pomijane i liczone jako przegapione, żeby
+        // kolejne tury wróciły do stałego rytmu zamiast nadrabiać zaległości
+        // seriami. Przy zerowym turn_duration tury są rozgrywane jedna za
+        // drugą, bez terminów do przegapienia.
+        void advance_deadline() {
+            if (turn_duration == 0) {
+                next_deadline = TickScheduler::clock::now();
+                return;
             }
+            const boost::chrono::milliseconds period(turn_duration);
+            next_deadline += period;
+            auto now = TickScheduler::clock::now();
+            if (now >= next_deadline) {
+                auto behind = (now - next_deadline) / period + 1;
+                missed_deadlines += behind;
+                next_deadline += behind * period;
+            }
+        }
 
-            boost::this_thread::sleep_for(
-                    boost::chrono::milliseconds(turn_duration));
+        // Metoda sprawdzająca, czy w pokoju trwa lobby.
+        bool in_lobby() {
+            boost::lock_guard<boost::mutex> guard(mutex);
+            return game_state == LOBBY;
+        }
+
+        // Metoda przeprowadzająca kolejną turę. Jest wywoływana przez
+        // scheduler w terminach wyznaczonych od początku gry, więc czas
+        // obsługi tury nie opóźnia kolejnych.
+        // return - termin kolejnej tury lub nullopt, jeżeli gra się skończyła
+        optional<TickScheduler::clock::time_point> make_turn() {
             boost::unique_lock<boost::mutex> lock(mutex);
-            // Zniszczone bloki w tej turze.
-            position_set destroyed_blocks;
-            // Zniszczone roboty w tej turze.
-            unordered_set<player_num_t> destroyed_robots;
-            // Bomby, które wybuchły w tej turze.
-            unordered_set<bomb_id_t> exploded_bombs;
-            // Bloki postawione przez graczy.
-            position_set new_blocks;
-            game_turn_t gm;
-            gm.turn = current_turn++;
-
-            // Obsługa bomb.
-            for (auto &bomb: bombs) {
-                bomb.second.timer--;
-                if (bomb.second.timer == 0) {
-                    bomb_exploded_t bomb_exploded_event;
-                    bomb_exploded_event.bomb_id = bomb.first;
-                    position_set explosions =
-                            handle_explosions(bomb.second.position);
-
-                    // Usuwanie bloków.
-                    for (const auto &explosion: explosions) {
-                        if (blocks.contains(explosion)) {
-                            destroyed_blocks.insert(explosion);
-                            bomb_exploded_event.blocks_destroyed
-                                .insert(explosion);
-                        }
-                    }
-                    // Niszczenie robotów.
-                    for (size_t i = 0; i < players.size(); i++) {
-                        if (explosions.contains(players[i].get_position())) {
-                            destroyed_robots
-                                .insert(static_cast<player_num_t>(i));
-                            bomb_exploded_event
-                                    .robots_destroyed
-                                    .insert(static_cast<player_num_t>(i));
-                        }
-                    }
-                    gm.events.push_back(bomb_exploded_event);
-                    exploded_bombs.insert(bomb.first);
-                }
+            if (game_state != GAME)
+                return nullopt;
+            actions.clear();
+            for (auto &player: players)
+                actions.push_back(player.take_action());
+            publication_t &p = claim_publication();
+            engine.step(actions, p.turn);
+
+            add_turn(p);
+            advance_deadline();
+            if (engine.is_over()) {
+                p.game_ended = end_game();
+                commit_publication();
+                return nullopt;
             }
+            commit_publication();
+            return next_deadline;
+        }
 
-            for (const auto &bomb: exploded_bombs) {
-                bombs.erase(bomb);
-            }
+        // Metoda etapu rozsyłania, uruchamiana przez scheduler po
+        // wstawieniu porcji do bufora.
+        void publish_pending() {
+            // Porcja wstawiona po wyzerowaniu flagi ponownie uruchomi etap.
+            publisher_woken = false;
+            boost::lock_guard<boost::mutex> guard(publish_mutex);
+            publish_all();
+        }
 
-            for (const auto &block: destroyed_blocks) {
-                blocks.erase(block);
-            }
+        // Metoda obsługująca wszystkie komunikaty odebrane od serwerów od
+        // ostatniego wywołania. Mutex game mastera jest zajmowany raz na całą
+        // paczkę komunikatów.
+        // - messages - wiadomości od serwerów
+        void handle_server_messages(vector<game_master_message_t> &messages) {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            for (auto &m: messages)
+                handle_server_message(m);
+        }
+    };
 
-            // Obsługa akcji graczy.
-            for (size_t i = 0; i < players.size(); i++) {
-                if (destroyed_robots.contains(static_cast<player_num_t>(i))) {
-                    players[i].set_position(random_position());
-                    players[i].inc_score();
-                    player_moved_t player_moved_event{
-                        static_cast<player_num_t>(i),
-                        players[i].get_position()};
-                    gm.events.push_back(player_moved_event);
-                }
-                else {
-                    if (players[i].get_action()) {
-                        handle_player_action(static_cast<player_num_t>(i),
-                                             *players[i].get_action(),
-                                             new_blocks, gm.events);
-                    }
-                }
-                players[i].set_action(nullopt);
+    // Klasa rozdzielająca komunikaty sesji pomiędzy pokoje. Klient dostaje
+    // komunikat HELLO zaraz po połączeniu, jeszcze przed wysłaniem CS_JOIN,
+    // więc pokój jest wybierany przy otwarciu sesji: nowa sesja trafia do
+    // pierwszego pokoju, w którym trwa lobby i jest mniej sesji niż graczy
+    // potrzebnych do gry, a gdy takiego nie ma, do pokoju z najmniejszą
+    // liczbą sesji. Metody wywołuje tylko wątek obsługujący kolejkę game
+    // mastera.
+    class RoomDispatcher {
+    private:
+        vector<unique_ptr<GameMaster>> rooms;
+        const player_num_t players_count;
+        // Pokój każdej podłączonej sesji.
+        unordered_map<server_id_t, size_t> session_rooms;
+        // Liczba sesji w każdym z pokojów.
+        vector<size_t> room_sessions;
+        // Komunikaty czekające na przekazanie do każdego z pokojów.
+        vector<vector<game_master_message_t>> batches;
+
+        // Metoda wybierająca pokój dla nowej sesji.
+        size_t choose_room() {
+            size_t least = 0;
+            for (size_t i = 0; i < rooms.size(); i++) {
+                if (room_sessions[i] < players_count && rooms[i]->in_lobby())
+                    return i;
+                if (room_sessions[i] < room_sessions[least])
+                    least = i;
             }
+            return least;
+        }
 
-            for (const auto &block: new_blocks) {
-                blocks.insert(block);
+        // Metoda wyznaczająca pokój, do którego należy komunikat.
+        // - m - komunikat od sesji
+        // return - numer pokoju lub nullopt, jeżeli sesja nie należy do
+        //          żadnego pokoju
+        optional<size_t> route(const game_master_message_t &m) {
+            if (holds_alternative<session_opened_t>(m.message)) {
+                size_t room = choose_room();
+                session_rooms[m.server_id] = room;
+                room_sessions[room]++;
+                return room;
             }
 
-            send_next_turn(gm, server_queues);
-            game_turns.push_back(gm);
-            if (current_turn > game_length) {
-                end_game(server_queues);
+            auto it = session_rooms.find(m.server_id);
+            if (it == session_rooms.end())
+                return nullopt;
+            size_t room = it->second;
+            auto sm = get_if<simple_message_t>(&m.message);
+            if (sm && *sm == SESSION_CLOSED) {
+                session_rooms.erase(it);
+                room_sessions[room]--;
             }
+            return room;
         }
 
-        // Metoda obsługująca komunikat odebrany od serwera.
-        // - m - wiadomość od serwera
-        // - queues - lista wszystkich kolejek na których nasłuchują serwery.
-        void handle_server_message(game_master_message_t &m,
-                                   server_queue_list_t &queues) {
-            boost::unique_lock<boost::mutex> lock(mutex);
-            visit(Overload {
-                    [&](server_join_t &join) {
-                        handle_join(queues, join, m.server_id);
-                    },
-                    [&](move_t &move) {
-                        handle_move(m.server_id, move);
+    public:
+        // Konstruktor tworzący cp.rooms pokojów o ustawieniach z cp. Każdy
+        // pokój losuje z innego ziarna, a liczenie i rozsyłanie jego tur są
+        // dwoma zadaniami schedulera.
+        RoomDispatcher(const command_parameters_t &cp,
+                       TickScheduler &scheduler) :
+                players_count(cp.players_count),
+                room_sessions(cp.rooms, 0), batches(cp.rooms) {
+            for (uint16_t i = 0; i < cp.rooms; i++) {
+                command_parameters_t room_cp = cp;
+                room_cp.seed = static_cast<seed_t>(cp.seed ^ (i * 0x9e3779b9u));
+                auto task = scheduler.add([this, i]() {
+                    return rooms[i]->make_turn();
+                });
+                auto publisher = scheduler.add([this, i]() {
+                    rooms[i]->publish_pending();
+                    return optional<TickScheduler::clock::time_point>();
+                });
+                rooms.push_back(make_unique<GameMaster>(
+                    room_cp,
+                    [&scheduler, task](TickScheduler::clock::time_point when) {
+                        scheduler.schedule(task, when);
                     },
-                    [&](simple_message_t &sm) {
-                        switch (sm) {
-                            case RESET_SERVER:
-                                reset_server(m.server_id, queues[m.server_id]);
-                                break;
-                            case CS_PLACE_BOMB:
-                                handle_place_bomb(m.server_id);
-                                break;
-                            case CS_PLACE_BLOCK:
-                                handle_place_block(m.server_id);
-                                break;
-                        }
-                    }
-            }, m.message);
+                    [&scheduler, publisher]() {
+                        scheduler.post(publisher);
+                    }));
+            }
+        }
+
+        // Metoda przekazująca komunikaty do pokojów. Każdy pokój dostaje
+        // swoje komunikaty jedną paczką, w kolejności odebrania.
+        // - messages - wiadomości od serwerów
+        void dispatch(vector<game_master_message_t> &messages) {
+            for (auto &m: messages) {
+                if (auto room = route(m))
+                    batches[*room].push_back(move(m));
+            }
+            for (size_t i = 0; i < rooms.size(); i++) {
+                if (batches[i].empty()) continue;
+                rooms[i]->handle_server_messages(batches[i]);
+                batches[i].clear();
+            }
         }
     };
 
-    // Funkcja obsługująca serwery komunikujące się z game masterem i klientami.
+    // Funkcja obsługująca serwer komunikujący się z game masterem i klientami.
     // - cp - wczytane parametry programu
     void handle_servers(const command_parameters_t &cp) {
         as::io_context io_context;
-        tcp::acceptor acceptor(io_context, tcp::endpoint(tcp::v6(), cp.port));
-        boost::mutex mutex;
-        vector<boost::thread> servers;
+        auto work = as::make_work_guard(io_context);
         // Kolejka na której nasłuchuje game master.
         gm_queue_t game_master_queue;
-        // Kolejki na których nasłuchują serwery.
-        server_queue_list_t server_queues;
-
-        for (server_id_t i = 0; i < NUMBER_OF_CLIENTS; i++) {
-            servers.emplace_back(
-                    [&mutex, &io_context, &acceptor, &game_master_queue,
-                            &server_queues]
-                            (server_id_t id) {
-                        while (true) {
-                            mutex.lock();
-                            tcp::socket socket(io_context);
-                            acceptor.accept(socket);
-                            mutex.unlock();
-
-                            socket.set_option(tcp::no_delay(true));
-                            std::ostringstream client_address;
-                            client_address << socket.remote_endpoint();
-                            TCPConnection con(socket);
-                            DatagramWriter writer(&con);
-                            DatagramReader reader(&con);
-
-                            client_connect(game_master_queue,
-                                           server_queues[id], id);
-
-                            Latch threads_still_running(1);
-
-                            // Wątek czytający od klienta.
-                            boost::thread receiver{[&]() {
-                                try {
-                                    receive_from_client(game_master_queue,
-                                                        reader, id,
-                                                        client_address.str());
-                                }
-                                catch (exception &err) {
-                                    threads_still_running.decrease();
-                                }
-                            }};
-                            // Wątek wysyłający do klienta
-                            boost::thread sender{[&]() {
-                                try {
-                                    send_to_client(writer, server_queues[id]);
-                                }
-                                catch (exception &err) {
-                                    threads_still_running.decrease();
-                                }
-                            }};
-
-                            threads_still_running.wait();
-                            sender.interrupt();
-                            receiver.interrupt();
-
-                            socket.close();
-                        }
-                    }, i
-            );
-        }
 
-        GameMaster gm(cp);
-        // Wątek obsługujący kolejne tury gry.
-        boost::thread clock{[&]() {
-            while (true) {
-                gm.make_turn(server_queues);
-            }
-        }};
+        Server server(io_context, cp.port, game_master_queue);
+        server.start();
+
+        // Wątki obsługujące operacje wejścia-wyjścia wszystkich sesji.
+        boost::thread_group io_threads;
+        for (uint16_t i = 0; i < cp.io_threads; i++)
+            io_threads.create_thread([&io_context]() { io_context.run(); });
+
+        // Wątki rozgrywające tury wszystkich pokojów.
+        TickScheduler scheduler(cp.tick_threads);
+        RoomDispatcher dispatcher(cp, scheduler);
+        scheduler.start_threads();
 
-        // Obsługa serwerów w gaame masterze
+        // Obsługa serwerów w game masterach
+        vector<game_master_message_t> messages;
         while (true) {
-            game_master_message_t m = game_master_queue.pop();
-            gm.handle_server_message(m, server_queues);
+            game_master_queue.pop_all(messages);
+            dispatcher.dispatch(messages);
+            messages.clear();
         }
     }
 }
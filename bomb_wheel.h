@@ -0,0 +1,120 @@
+#ifndef BOMB_WHEEL_H
+#define BOMB_WHEEL_H
+#include <cstddef>
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "message_types.h"
+
+// Klasa przechowująca bomby leżące na planszy. Bomby są trzymane w kole, w
+// którym przegródka odpowiada turze wybuchu, więc tura dotyka tylko bomb,
+// które w niej wybuchają. Koło ma co najwyżej MAX_SLOTS przegródek.
+// Wszystkie bomby wybuchają po tej samej liczbie tur, więc bomby, które
+// czekają dłużej niż jeden obrót koła, trafiają do kolejki w kolejności
+// wybuchu i przechodzą do koła, gdy ich tura wejdzie w zasięg obrotu. Same
+// bomby leżą w ciągłej tablicy, a zwolnione miejsca są ponownie używane.
+class BombWheel {
+public:
+    // Największa liczba przegródek koła.
+    static constexpr uint64_t MAX_SLOTS = 256;
+
+private:
+    struct slab_bomb_t {
+        bomb_id_t id;
+        position_t position;
+        uint64_t explosion_tick; // Tyknięcie, w którym bomba wybuchnie.
+        bool live;
+    };
+
+    const uint64_t period; // Liczba tur od postawienia bomby do wybuchu.
+    std::vector<slab_bomb_t> slab;
+    std::vector<uint32_t> free_slots;
+    std::vector<std::vector<uint32_t>> wheel; // Indeksy bomb w slab.
+    // Indeksy bomb, które wybuchną później niż za jeden obrót koła.
+    std::deque<uint32_t> overflow;
+    uint64_t ticks; // Liczba tur od początku gry.
+
+    // Metoda wstawiająca bombę do przegródki tury jej wybuchu.
+    void add_to_wheel(const uint32_t index) {
+        wheel[slab[index].explosion_tick % wheel.size()].push_back(index);
+    }
+
+public:
+    // Konstruktor koła. Licznik bomby równy 0 oznacza, tak jak przy
+    // odliczaniu na liczniku 16-bitowym, wybuch po 65536 turach. Jeżeli bomba
+    // nie zdąży wybuchnąć przed końcem gry, koło nie ma przegródek.
+    // - bomb_timer - liczba tur od postawienia bomby do wybuchu
+    // - game_length - długość gry w turach
+    BombWheel(const game_time_t bomb_timer, const game_time_t game_length) :
+            period(bomb_timer == 0 ? uint64_t{1} << 16 : bomb_timer),
+            wheel(period < game_length ? std::min(period, MAX_SLOTS) : 0),
+            ticks(0) {}
+
+    // Metoda stawiająca bombę w bieżącej turze.
+    // - id - id bomby
+    // - p - pole bomby
+    void place(const bomb_id_t id, const position_t p) {
+        uint32_t index;
+        if (!free_slots.empty()) {
+            index = free_slots.back();
+            free_slots.pop_back();
+            slab[index] = {id, p, ticks + period, true};
+        }
+        else {
+            index = static_cast<uint32_t>(slab.size());
+            slab.push_back({id, p, ticks + period, true});
+        }
+        if (wheel.empty())
+            return;
+        if (period <= wheel.size())
+            add_to_wheel(index);
+        else
+            overflow.push_back(index);
+    }
+
+    // Metoda przechodząca do kolejnej tury i wywołująca f(id, pole) dla
+    // każdej bomby, która w niej wybucha. Bomby są usuwane po wywołaniu f.
+    template<class F>
+    void tick(F f) {
+        ticks++;
+        if (wheel.empty()) return;
+        // Bomby z kolejki, które wybuchną w ciągu obrotu koła.
+        while (!overflow.empty()
+               && slab[overflow.front()].explosion_tick < ticks + wheel.size()) {
+            add_to_wheel(overflow.front());
+            overflow.pop_front();
+        }
+        auto &slot = wheel[ticks % wheel.size()];
+        for (const auto index: slot) {
+            slab_bomb_t &bomb = slab[index];
+            f(bomb.id, bomb.position);
+            bomb.live = false;
+            free_slots.push_back(index);
+        }
+        slot.clear();
+    }
+
+    // Metoda wywołująca f(id, bomba) dla każdej bomby na planszy. Licznik
+    // bomby to liczba tur pozostałych do wybuchu.
+    template<class F>
+    void for_each(F f) const {
+        for (const auto &bomb: slab) {
+            if (!bomb.live) continue;
+            f(bomb.id, bomb_t{bomb.position, static_cast<game_time_t>(
+                    bomb.explosion_tick - ticks)});
+        }
+    }
+
+    void clear() {
+        slab.clear();
+        free_slots.clear();
+        for (auto &slot: wheel)
+            slot.clear();
+        overflow.clear();
+        ticks = 0;
+    }
+};
+
+#endif // BOMB_WHEEL_H
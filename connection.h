@@ -4,6 +4,11 @@
 #include <exception>
 #include <unordered_set>
 #include <iostream>
+#include <utility>
+#include <stdexcept>
+#include <span>
+#include <algorithm>
+#include <cstring>
 
 #include <boost/asio.hpp>
 #include <boost/array.hpp>
@@ -33,19 +38,27 @@ using host_address_t = struct host_address {
 };
 const host_address_t INVALID_ADDRESS = {"", ""};
 
-// Klasa abstrakcyjna obsługująca komunikację sieciową.
+// Klasa abstrakcyjna obsługująca komunikację sieciową. DatagramReader i
+// DatagramWriter są szablonami parametryzowanymi typem obsługi komunikacji,
+// więc wywołania read_some i send na konkretnej, finalnej klasie nie przechodzą
+// przez tablicę metod wirtualnych. Interfejs wirtualny służy tylko jako
+// adapter dla kodu, który nie zna konkretnego typu.
 class MessageHandler {
 public:
     // Metoda wczytująca bajty bufora data.
     // data - bufor na który są wczytywane bajty.
     virtual void read_some(datagram_t &data) const = 0;
+    // Metoda wczytująca dostępne bajty do bufora buf.
+    // buf - miejsce na wczytane bajty
+    // return - liczba wczytanych bajtów
+    virtual size_t read_some(std::span<char> buf) const = 0;
     // Metoda wysyłająca datagram data do serwera.
     // data - bufor, który zostaje wysłany
     virtual void send(const datagram_t &data) const = 0;
 };
 
 // Klasa przedstawiająca klienta komunikującego się z serwerem UDP.
-class UDPClient : public MessageHandler {
+class UDPClient final : public MessageHandler {
 protected:
     as::io_context io_context;
     udp::resolver resolver;
@@ -93,6 +106,16 @@ public:
         }
     }
 
+    size_t read_some(std::span<char> buf) const override {
+        try {
+            return socket.receive(as::buffer(buf.data(), buf.size()));
+        }
+        catch (std::exception &err) {
+            error_handler(err);
+        }
+        return 0;
+    }
+
     void send(const datagram_t &data) const override {
         try {
             socket.send_to(as::buffer(data.buf, data.len), endpoint);
@@ -104,7 +127,7 @@ public:
 };
 
 // Klasa przedstawiająca klienta komunikującego się z serwerem TCP.
-class TCPClient : public MessageHandler {
+class TCPClient final : public MessageHandler {
 protected:
     as::io_context io_context;
     tcp::resolver resolver;
@@ -158,6 +181,16 @@ public:
         }
     }
 
+    size_t read_some(std::span<char> buf) const override {
+        try {
+            return socket.read_some(as::buffer(buf.data(), buf.size()));
+        }
+        catch (std::exception &err) {
+            error_handler(err);
+        }
+        return 0;
+    }
+
     void send(const datagram_t &data) const override {
         try {
             socket.send(as::buffer(data.buf, data.len));
@@ -168,98 +201,145 @@ public:
     }
 };
 
-// Klasa obsługująca połączenie z klientem po TCP.
-class TCPConnection : public MessageHandler {
+// Klasa zbierająca wysyłane datagramy w buforze w pamięci. Pozwala
+// zakodować komunikat bez wysyłania go od razu przez gniazdo.
+class BufferHandler final : public MessageHandler {
 private:
-    mutable tcp::socket socket;
+    mutable flex_buf_t buf;
 
 public:
-    TCPConnection(tcp::socket &_socket) :
-        socket(std::move(_socket)) {}
+    void read_some(datagram_t &) const override {
+        throw std::logic_error("BufferHandler is write-only");
+    }
 
-    void read_some(datagram_t &data) const override {
-        data.len = static_cast<datagram_size_t>(socket.read_some(
-                as::buffer(data.buf)));
+    size_t read_some(std::span<char>) const override {
+        throw std::logic_error("BufferHandler is write-only");
     }
 
     void send(const datagram_t &data) const override {
-        socket.send(as::buffer(data.buf, data.len));
+        buf.insert(buf.end(), data.buf.begin(), data.buf.begin() + data.len);
+    }
+
+    // Metoda zwracająca zebrane bajty.
+    flex_buf_t &buffer() {
+        return buf;
     }
 };
 
-// Klasa pomagająca w czytaniu z serwera.
-class DatagramReader {
+// Początkowy rozmiar bufora odbiorczego DatagramReader.
+constexpr size_t READER_BUFFER_SIZE = 4096;
+
+// Klasa pomagająca w czytaniu z serwera. Pola są dekodowane bezpośrednio z
+// bufora, do którego odbierane są bajty. Kopiowana jest tylko niedokończona
+// końcówka bufora, gdy pole nie mieści się w odebranych bajtach.
+// Handler - klasa, z której odbierane są bajty, np. TCPClient
+template<class Handler>
+class BasicDatagramReader {
 private:
-    MessageHandler* handler;
-    datagram_t data{};
-    size_t read_ptr;
-
-    // Metoda zwracająca kolejne bytes bajtów otrzymanych od serwera.
-    // bytes - liczba bajtów do pozyskania
-    // return - bufor zapełniony bytes bajtami od serwera
-    flex_buf_t prepare_buf(const size_t bytes) {
-        flex_buf_t res{};
-        for (size_t i = 0; i < bytes; i++) {
-            if (read_ptr >= data.len) {
-                handler->read_some(data);
-                read_ptr = 0;
-                i--;
-                continue;
-            }
-            res.push_back(data.buf[read_ptr++]);
+    Handler* handler;
+    flex_buf_t buf;  // Bufor odbiorczy.
+    size_t read_ptr; // Pierwszy nieprzeczytany bajt bufora.
+    size_t end;      // Koniec odebranych bajtów.
+
+public:
+    explicit BasicDatagramReader(Handler* _handler) :
+            handler(_handler), buf(READER_BUFFER_SIZE), read_ptr(0), end(0) {}
+
+    // Metoda zapewniająca, że od read_ptr w buforze leży co najmniej bytes
+    // odebranych bajtów. W razie potrzeby przesuwa nieprzeczytane bajty na
+    // początek bufora, powiększa go i odbiera kolejne bajty od serwera.
+    // bytes - liczba potrzebnych bajtów
+    void ensure(const size_t bytes) {
+        if (end - read_ptr >= bytes) return;
+        if (read_ptr == end)
+            read_ptr = end = 0;
+        if (buf.size() - read_ptr < bytes) {
+            std::memmove(buf.data(), buf.data() + read_ptr, end - read_ptr);
+            end -= read_ptr;
+            read_ptr = 0;
+            if (buf.size() < bytes)
+                buf.resize(std::max(bytes, 2 * buf.size()));
+        }
+        while (end - read_ptr < bytes) {
+            end += handler->read_some(
+                    std::span<char>(buf.data() + end, buf.size() - end));
         }
-        return res;
     }
 
-public:
-    explicit DatagramReader(MessageHandler* _handler) :
-            handler(_handler), read_ptr(0) {
-        data.buf = {};
-        data.len = 0;
-    };
+    // Metody czytające pole bez sprawdzania, czy zostało odebrane. Wymagają
+    // wcześniejszego wywołania ensure dla wszystkich czytanych bajtów.
+    void get(uint8_t &n) {
+        n = static_cast<uint8_t>(buf[read_ptr++]);
+    }
+
+    void get(uint16_t &n) {
+        memcpy(&n, buf.data() + read_ptr, sizeof(uint16_t));
+        read_ptr += sizeof(uint16_t);
+        n = ntohs(n);
+    }
+
+    void get(uint32_t &n) {
+        memcpy(&n, buf.data() + read_ptr, sizeof(uint32_t));
+        read_ptr += sizeof(uint32_t);
+        n = ntohl(n);
+    }
+
+    void get(position_t &position) {
+        get(position.x);
+        get(position.y);
+    }
+
+    // Metoda zwracająca widok na kolejne bytes bajtów. Widok jest ważny do
+    // następnego odczytu.
+    std::span<const char> read_bytes(const size_t bytes) {
+        ensure(bytes);
+        std::span<const char> res(buf.data() + read_ptr, bytes);
+        read_ptr += bytes;
+        return res;
+    }
 
-    DatagramReader* read(player_t &player) {
+    BasicDatagramReader* read(player_t &player) {
         return read(player.name)->read(player.address);
     }
 
-    DatagramReader* read(position_t &position) {
+    BasicDatagramReader* read(position_t &position) {
         return read(position.x)->read(position.y);
     }
 
-    DatagramReader* read(name_t &name) {
+    BasicDatagramReader* read(name_t &name) {
         uint8_t str_len;
         read(str_len);
-        flex_buf_t buf = prepare_buf(str_len);
-        std::copy_n(buf.begin(), str_len, name.name.begin());
+        std::span<const char> str = read_bytes(str_len);
+        std::copy_n(str.begin(), str_len, name.name.begin());
         name.len = str_len;
         return this;
     }
 
-    DatagramReader* read(uint8_t &n) {
-        flex_buf_t buf = prepare_buf(sizeof(uint8_t));
-        n = static_cast<uint8_t>(buf[0]);
+    BasicDatagramReader* read(uint8_t &n) {
+        ensure(sizeof(uint8_t));
+        get(n);
         return this;
     }
 
-    DatagramReader* read(uint16_t &n) {
-        flex_buf_t buf = prepare_buf(sizeof(uint16_t));
-        memcpy(&n, buf.data(), sizeof(uint16_t));
-        n = ntohs(n);
+    BasicDatagramReader* read(uint16_t &n) {
+        ensure(sizeof(uint16_t));
+        get(n);
         return this;
     }
 
-    DatagramReader* read(uint32_t &n) {
-        flex_buf_t buf = prepare_buf(sizeof(uint32_t));
-        memcpy(&n, buf.data(), sizeof(uint32_t));
-        n = ntohl(n);
+    BasicDatagramReader* read(uint32_t &n) {
+        ensure(sizeof(uint32_t));
+        get(n);
         return this;
     }
 };
 
 // Klasa pomagająca w wysyłaniu komunikatów.
-class DatagramWriter {
+// Handler - klasa, przez którą wysyłane są datagramy, np. UDPClient
+template<class Handler>
+class BasicDatagramWriter {
 private:
-    MessageHandler* handler;
+    Handler* handler;
     datagram_t data;
 
     // Metoda sprawdzająca czy jest wolnych bytes bajtów do zapisania w buforze.
@@ -271,8 +351,45 @@ private:
             data.len = 0;
         }
     }
+
+    template<class T>
+    void put_raw(const T n) {
+        memcpy(data.buf.begin() + data.len, &n, sizeof(T));
+        data.len = static_cast<datagram_size_t>(data.len + sizeof(T));
+    }
 public:
-    explicit DatagramWriter(MessageHandler* _client) : handler(_client) {
+    // Metoda zapewniająca w buforze miejsce na bytes bajtów, które zostaną
+    // zapisane metodami put.
+    void reserve(const size_t bytes) {
+        prepare_buf(bytes);
+    }
+
+    // Metody zapisujące pole bez sprawdzania miejsca w buforze. Wymagają
+    // wcześniejszego wywołania reserve dla wszystkich zapisywanych bajtów.
+    void put(const uint8_t n) {
+        put_raw(n);
+    }
+
+    void put(const uint16_t n) {
+        put_raw(htons(n));
+    }
+
+    void put(const uint32_t n) {
+        put_raw(htonl(n));
+    }
+
+    void put(const position_t &position) {
+        put(position.x);
+        put(position.y);
+    }
+
+    void put(const name_t &name) {
+        put(name.len);
+        std::copy_n(name.name.begin(), name.len, data.buf.begin() + data.len);
+        data.len = static_cast<datagram_size_t>(data.len + name.len);
+    }
+
+    explicit BasicDatagramWriter(Handler* _client) : handler(_client) {
         data.buf = {};
         data.len = 0;
     };
@@ -282,11 +399,11 @@ public:
         data.len = 0;
     }
 
-    DatagramWriter* write(const player_t &player) {
+    BasicDatagramWriter* write(const player_t &player) {
         return write(player.name)->write(player.address);
     }
 
-    DatagramWriter* write(const std::string &str) {
+    BasicDatagramWriter* write(const std::string &str) {
         write(static_cast<uint8_t>(str.length()));
         prepare_buf(str.length());
         std::copy_n(str.begin(), str.length(), data.buf.begin() + data.len);
@@ -294,47 +411,40 @@ public:
         return this;
     }
 
-    DatagramWriter* write(const uint8_t n) {
+    BasicDatagramWriter* write(const uint8_t n) {
         prepare_buf(sizeof(uint8_t));
-        memcpy(data.buf.begin() + data.len, &n, sizeof(uint8_t));
-        data.len = static_cast<datagram_size_t>(data.len + sizeof(uint8_t));
+        put(n);
         return this;
     }
 
-    DatagramWriter* write(const uint16_t n) {
+    BasicDatagramWriter* write(const uint16_t n) {
         prepare_buf(sizeof(uint16_t));
-        uint16_t net_n = htons(n);
-        memcpy(data.buf.begin() + data.len, &net_n, sizeof(uint16_t));
-        data.len = static_cast<datagram_size_t>(data.len + sizeof(uint16_t));
+        put(n);
         return this;
     }
 
-    DatagramWriter* write(const uint32_t n) {
+    BasicDatagramWriter* write(const uint32_t n) {
         prepare_buf(sizeof(uint32_t));
-        uint32_t net_n = htonl(n);
-        memcpy(data.buf.begin() + data.len, &net_n, sizeof(uint32_t));
-        data.len = static_cast<datagram_size_t>(data.len + sizeof(uint32_t));
+        put(n);
         return this;
     }
 
-    DatagramWriter* write(const name_t &name) {
-        write(name.len);
-        prepare_buf(name.len);
-        std::copy_n(name.name.begin(), name.len, data.buf.begin() + data.len);
-        data.len = static_cast<datagram_size_t>(data.len + name.len);
+    BasicDatagramWriter* write(const name_t &name) {
+        prepare_buf(sizeof(uint8_t) + name.len);
+        put(name);
         return this;
     }
 
-    DatagramWriter* write(const position_t &position) {
+    BasicDatagramWriter* write(const position_t &position) {
         return write(position.x)->write(position.y);
     }
 
-    DatagramWriter* write(const bomb_t &bomb) {
+    BasicDatagramWriter* write(const bomb_t &bomb) {
         return write(bomb.position)->write(bomb.timer);
     }
 
     template<class T, class V>
-    DatagramWriter* write(const std::unordered_map<T, V> &m) {
+    BasicDatagramWriter* write(const std::unordered_map<T, V> &m) {
         write(static_cast<container_size_t>(m.size()));
         for (const auto &item: m) {
             write(item.first)->write(item.second);
@@ -342,7 +452,7 @@ public:
         return this;
     }
 
-    DatagramWriter* write(const position_set &s) {
+    BasicDatagramWriter* write(const position_set &s) {
         write(static_cast<container_size_t>(s.size()));
         for (const auto &item: s) {
             write(item);
@@ -351,7 +461,7 @@ public:
     }
 
     template<class T>
-    DatagramWriter* write(const std::unordered_set<T> &s) {
+    BasicDatagramWriter* write(const std::unordered_set<T> &s) {
         write(static_cast<container_size_t>(s.size()));
         for (const auto &item: s) {
             write(item);
@@ -365,4 +475,8 @@ public:
     }
 };
 
+// Reader i writer korzystające z wirtualnego interfejsu MessageHandler.
+using DatagramReader = BasicDatagramReader<MessageHandler>;
+using DatagramWriter = BasicDatagramWriter<MessageHandler>;
+
 #endif // CONNECTION_H
\ No newline at end of file
@@ -0,0 +1,149 @@
+#include "game_engine.h"
+
+GameEngine::GameEngine(const game_settings_t &_settings) :
+        settings(_settings), random(_settings.seed),
+        blocks(_settings.size_x, _settings.size_y),
+        robots(_settings.size_x, _settings.size_y),
+        bombs(_settings.bomb_timer, _settings.game_length) {
+    clear();
+}
+
+bool GameEngine::is_position_valid(const position_t position) const {
+    return position.x < settings.size_x && position.y < settings.size_y;
+}
+
+position_t GameEngine::random_position() {
+    return {static_cast<coords_t>(random() % settings.size_x),
+            static_cast<coords_t>(random() % settings.size_y)};
+}
+
+// Metoda przestawiająca robota gracza id na pole p.
+void GameEngine::move_robot(const player_num_t id, const position_t p) {
+    robots.move(id, p);
+    positions[id] = p;
+}
+
+// Metoda obsługująca ruch gracza. Bloki postawione w turze są dodawane do
+// planszy na jej końcu.
+void GameEngine::handle_player_action(const player_num_t id,
+                                      const player_action_t &act,
+                                      TurnEvents &events) {
+    if (auto action = std::get_if<PlayerAction>(&act)) {
+        switch (*action) {
+            case PLACE_BLOCK:
+                events.block_placed(positions[id]);
+                placed_blocks.push_back(positions[id]);
+                break;
+            case PLACE_BOMB:
+                events.bomb_placed(bomb_count, positions[id]);
+                bombs.place(bomb_count++, positions[id]);
+                break;
+        }
+        return;
+    }
+
+    position_t np = positions[id];
+    switch (std::get<move_t>(act).direction) {
+        case UP:
+            np = {np.x, static_cast<coords_t>(np.y + 1)};
+            break;
+        case RIGHT:
+            np = {static_cast<coords_t>(np.x + 1), np.y};
+            break;
+        case DOWN:
+            np = {np.x, static_cast<coords_t>(np.y - 1)};
+            break;
+        case LEFT:
+            np = {static_cast<coords_t>(np.x - 1), np.y};
+            break;
+    }
+    if (is_position_valid(np) && !blocks.contains(np)) {
+        move_robot(id, np);
+        events.player_moved(id, np);
+    }
+}
+
+void GameEngine::start(const player_num_t players, game_turn_t &turn) {
+    turn.turn = current_turn++;
+    turn.events.clear();
+    positions.resize(players);
+    scores.assign(players, 0);
+    for (player_num_t i = 0; i < players; i++) {
+        position_t new_position = random_position();
+        positions[i] = new_position;
+        robots.add(i, new_position);
+        turn.events.player_moved(i, new_position);
+    }
+
+    for (block_count_t i = 0; i < settings.initial_blocks; i++) {
+        position_t new_position = random_position();
+        if (!blocks.insert(new_position)) continue;
+        turn.events.block_placed(new_position);
+    }
+}
+
+void GameEngine::step(
+        const std::span<const std::optional<player_action_t>> actions,
+        game_turn_t &turn) {
+    turn.turn = current_turn++;
+    turn.events.clear();
+    destroyed_robots.assign(positions.size(), false);
+    placed_blocks.clear();
+
+    // Obsługa bomb, które wybuchają w tej turze.
+    bombs.tick([&](const bomb_id_t bomb_id, const position_t position) {
+        blast_t blast = blocks.blast(position, settings.explosion_radius);
+        turn.events.bomb_exploded(bomb_id, position);
+
+        // Usuwanie bloków.
+        blast.for_each_end([&](const position_t end) {
+            if (blocks.contains(end))
+                turn.events.block_destroyed(end);
+        });
+        // Niszczenie robotów.
+        robots.for_each_in(blast, [&](const player_num_t id) {
+            destroyed_robots[id] = true;
+            turn.events.robot_destroyed(id);
+        });
+    });
+
+    blocks.erase_all(turn.events.destroyed_blocks());
+
+    // Obsługa akcji graczy.
+    for (size_t i = 0; i < positions.size(); i++) {
+        auto id = static_cast<player_num_t>(i);
+        if (destroyed_robots[i]) {
+            move_robot(id, random_position());
+            scores[i]++;
+            turn.events.player_moved(id, positions[i]);
+        }
+        else if (i < actions.size() && actions[i]) {
+            handle_player_action(id, *actions[i], turn.events);
+        }
+    }
+
+    // Bloki postawione przez graczy.
+    blocks.insert_all(placed_blocks);
+}
+
+game_snapshot_t GameEngine::snapshot() const {
+    game_snapshot_t snapshot;
+    snapshot.turn = static_cast<turn_t>(current_turn - 1);
+    snapshot.blocks = blocks.positions();
+    bombs.for_each([&](const bomb_id_t id, const bomb_t &bomb) {
+        snapshot.bombs.push_back({id, bomb});
+    });
+    snapshot.positions = positions;
+    snapshot.scores = scores;
+    return snapshot;
+}
+
+void GameEngine::clear() {
+    positions.clear();
+    scores.clear();
+    blocks.clear();
+    robots.clear();
+    bombs.clear();
+    bomb_count = 0;
+    current_turn = 0;
+}
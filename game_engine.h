@@ -0,0 +1,98 @@
+#ifndef GAME_ENGINE_H
+#define GAME_ENGINE_H
+#include <optional>
+#include <random>
+#include <span>
+#include <vector>
+
+#include "message_types.h"
+#include "block_grid.h"
+#include "robot_index.h"
+#include "bomb_wheel.h"
+#include "turn_events.h"
+
+using snapshot_bomb_t = struct snapshot_bomb_t {
+    bomb_id_t bomb_id;
+    bomb_t bomb;
+};
+
+// Migawka stanu gry po danej turze.
+using game_snapshot_t = struct game_snapshot_t {
+    turn_t turn;
+    std::vector<position_t> blocks;
+    std::vector<snapshot_bomb_t> bombs;
+    std::vector<position_t> positions; // Pozycje kolejnych graczy.
+    std::vector<score_t> scores;       // Wyniki kolejnych graczy.
+};
+
+// Ustawienia gry, od których zależą jej zasady.
+using game_settings_t = struct game_settings_t {
+    coords_t size_x;
+    coords_t size_y;
+    game_time_t game_length;
+    explosion_radius_t explosion_radius;
+    game_time_t bomb_timer;
+    block_count_t initial_blocks;
+    seed_t seed;
+};
+
+// Klasa przeprowadzająca grę według jej zasad, bez sieci, wątków i zegara.
+// Gracze są numerowani od 0, a każda tura to wywołanie step z akcjami
+// wszystkich graczy, które zapisuje zdarzenia tury do podanego bufora.
+// Generator liczb losowych nie jest zerowany między grami, więc kolejne gry
+// z tego samego obiektu przebiegają inaczej.
+class GameEngine {
+private:
+    const game_settings_t settings;
+    std::minstd_rand random;
+    std::vector<position_t> positions; // Pozycje kolejnych graczy.
+    std::vector<score_t> scores;       // Wyniki kolejnych graczy.
+    BlockGrid blocks;
+    // Pola zajęte przez roboty graczy.
+    RobotIndex robots;
+    BombWheel bombs;
+    // Roboty zniszczone w bieżącej turze.
+    std::vector<bool> destroyed_robots;
+    // Bloki postawione przez graczy w bieżącej turze.
+    std::vector<position_t> placed_blocks;
+    bomb_id_t bomb_count;
+    turn_t current_turn;
+
+    bool is_position_valid(position_t position) const;
+    position_t random_position();
+    void move_robot(player_num_t id, position_t p);
+    void handle_player_action(player_num_t id, const player_action_t &act,
+                              TurnEvents &events);
+
+public:
+    explicit GameEngine(const game_settings_t &_settings);
+
+    // Metoda rozpoczynająca grę: rozstawia roboty i początkowe bloki.
+    // - players - liczba graczy
+    // - turn - bufor, do którego trafiają zdarzenia zerowej tury
+    void start(player_num_t players, game_turn_t &turn);
+
+    // Metoda przeprowadzająca kolejną turę.
+    // - actions - akcje kolejnych graczy w tej turze, nullopt oznacza brak
+    //             akcji
+    // - turn - bufor, do którego trafiają zdarzenia tury
+    void step(std::span<const std::optional<player_action_t>> actions,
+              game_turn_t &turn);
+
+    // Metoda sprawdzająca, czy rozegrano już wszystkie tury gry.
+    bool is_over() const {
+        return current_turn > settings.game_length;
+    }
+
+    // Metoda tworząca migawkę stanu gry po ostatniej turze.
+    game_snapshot_t snapshot() const;
+
+    const std::vector<score_t> &get_scores() const {
+        return scores;
+    }
+
+    // Metoda czyszcząca stan po zakończonej grze.
+    void clear();
+};
+
+#endif // GAME_ENGINE_H
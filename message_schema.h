@@ -0,0 +1,190 @@
+#ifndef MESSAGE_SCHEMA_H
+#define MESSAGE_SCHEMA_H
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "message_types.h"
+#include "connection.h"
+
+// Opis, jak pole danego typu wygląda w protokole. Pola o stałym rozmiarze
+// mają fixed == true i rozmiar size znany w czasie kompilacji.
+template<class T>
+struct wire_field;
+
+template<class T>
+struct wire_integer {
+    static constexpr bool fixed = true;
+    static constexpr size_t size = sizeof(T);
+
+    static size_t size_of(const T &) { return size; }
+    template<class Writer>
+    static void put(Writer &dw, const T &v) { dw.put(v); }
+    template<class Reader>
+    static void get(Reader &dr, T &v) { dr.get(v); }
+};
+
+template<> struct wire_field<uint8_t> : wire_integer<uint8_t> {};
+template<> struct wire_field<uint16_t> : wire_integer<uint16_t> {};
+template<> struct wire_field<uint32_t> : wire_integer<uint32_t> {};
+
+template<>
+struct wire_field<position_t> {
+    static constexpr bool fixed = true;
+    static constexpr size_t size = 2 * sizeof(coords_t);
+
+    static size_t size_of(const position_t &) { return size; }
+    template<class Writer>
+    static void put(Writer &dw, const position_t &p) { dw.put(p); }
+    template<class Reader>
+    static void get(Reader &dr, position_t &p) { dr.get(p); }
+};
+
+template<>
+struct wire_field<name_t> {
+    static constexpr bool fixed = false;
+    static constexpr size_t size = 0;
+
+    static size_t size_of(const name_t &name) {
+        return sizeof(uint8_t) + name.len;
+    }
+    template<class Writer>
+    static void put(Writer &dw, const name_t &name) { dw.put(name); }
+    template<class Reader>
+    static void get(Reader &dr, name_t &name) { dr.read(name); }
+};
+
+template<>
+struct wire_field<player_t> {
+    static constexpr bool fixed = false;
+    static constexpr size_t size = 0;
+
+    static size_t size_of(const player_t &player) {
+        return wire_field<name_t>::size_of(player.name)
+               + wire_field<name_t>::size_of(player.address);
+    }
+    template<class Writer>
+    static void put(Writer &dw, const player_t &player) {
+        dw.put(player.name);
+        dw.put(player.address);
+    }
+    template<class Reader>
+    static void get(Reader &dr, player_t &player) {
+        dr.read(player);
+    }
+};
+
+template<class M>
+struct member_of;
+
+template<class C, class T>
+struct member_of<T C::*> {
+    using message_type = C;
+    using field_type = T;
+};
+
+// Szablon opisujący komunikat protokołu: bajt Id, po którym następują pola
+// Fields (wskaźniki na składowe jednej struktury) w podanej kolejności.
+// Z opisu powstają koder i dekoder komunikatu. Koder sprawdza miejsce w
+// buforze raz na cały komunikat, a dekoder raz na każdy ciąg sąsiednich pól
+// o stałym rozmiarze, którego długość jest znana w czasie kompilacji.
+template<message_id_t Id, auto First, auto... Rest>
+class MessageSchema {
+public:
+    using message_t = typename member_of<decltype(First)>::message_type;
+
+private:
+    static constexpr auto fields = std::make_tuple(First, Rest...);
+    static constexpr size_t field_count = 1 + sizeof...(Rest);
+
+    template<size_t I>
+    using field_t = wire_field<typename member_of<std::remove_cv_t<
+            std::tuple_element_t<I, decltype(fields)>>>::field_type>;
+
+    // Łączny rozmiar pól o stałym rozmiarze zaczynających się od pola I.
+    template<size_t I>
+    static constexpr size_t fixed_run() {
+        if constexpr (I == field_count) {
+            return 0;
+        }
+        else if constexpr (!field_t<I>::fixed) {
+            return 0;
+        }
+        else {
+            return field_t<I>::size + fixed_run<I + 1>();
+        }
+    }
+
+    // Czy pole I zaczyna ciąg pól o stałym rozmiarze.
+    template<size_t I>
+    static constexpr bool starts_run() {
+        if constexpr (!field_t<I>::fixed)
+            return false;
+        else if constexpr (I == 0)
+            return true;
+        else
+            return !field_t<I - 1>::fixed;
+    }
+
+    template<size_t I, class Reader>
+    static void get_field(Reader &dr, message_t &m) {
+        if constexpr (starts_run<I>())
+            dr.ensure(fixed_run<I>());
+        field_t<I>::get(dr, m.*std::get<I>(fields));
+    }
+
+    template<size_t... I>
+    static size_t size_of(const message_t &m, std::index_sequence<I...>) {
+        return sizeof(message_id_t)
+               + (field_t<I>::size_of(m.*std::get<I>(fields)) + ...);
+    }
+
+    template<class Writer, size_t... I>
+    static void put(Writer &dw, const message_t &m,
+                    std::index_sequence<I...>) {
+        dw.put(Id);
+        (field_t<I>::put(dw, m.*std::get<I>(fields)), ...);
+    }
+
+    template<class Reader, size_t... I>
+    static void get(Reader &dr, message_t &m,
+                    std::index_sequence<I...>) {
+        (get_field<I>(dr, m), ...);
+    }
+
+public:
+    static constexpr message_id_t id = Id;
+
+    // Metoda dopisująca komunikat m do writera.
+    template<class Writer>
+    static void write(Writer &dw, const message_t &m) {
+        auto seq = std::make_index_sequence<field_count>();
+        dw.reserve(size_of(m, seq));
+        put(dw, m, seq);
+    }
+
+    // Metoda czytająca pola komunikatu. Bajt Id musi być już przeczytany.
+    template<class Reader>
+    static void read(Reader &dr, message_t &m) {
+        get(dr, m, std::make_index_sequence<field_count>());
+    }
+};
+
+using hello_schema = MessageSchema<SC_HELLO,
+        &hello_t::server_name, &hello_t::players_count, &hello_t::size_x,
+        &hello_t::size_y, &hello_t::game_length, &hello_t::explosion_radius,
+        &hello_t::bomb_timer>;
+using accepted_player_schema = MessageSchema<SC_ACCEPTED_PLAYER,
+        &accepted_player_t::id, &accepted_player_t::player>;
+using turn_header_schema = MessageSchema<SC_TURN,
+        &turn_header_t::turn, &turn_header_t::events>;
+using bomb_placed_schema = MessageSchema<BOMB_PLACED,
+        &bomb_placed_t::bomb_id, &bomb_placed_t::position>;
+using player_moved_schema = MessageSchema<PLAYER_MOVED,
+        &player_moved_t::player_id, &player_moved_t::position>;
+using block_placed_schema = MessageSchema<BLOCK_PLACED,
+        &block_placed_t::position>;
+
+#endif // MESSAGE_SCHEMA_H
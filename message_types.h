@@ -76,36 +76,26 @@ using accepted_player_t = struct {
     player_t player;
 };
 
-using bomb_placed_t = struct {
-    bomb_id_t bomb_id;
-    position_t position;
+// Początek komunikatu SC_TURN, po którym następuje events zdarzeń.
+using turn_header_t = struct turn_header_t {
+    turn_t turn;
+    container_size_t events;
 };
 
-using bomb_exploded_t = struct {
+using bomb_placed_t = struct bomb_placed_t {
     bomb_id_t bomb_id;
-    player_list_t robots_destroyed;
-    position_set blocks_destroyed;
+    position_t position;
 };
 
-using player_moved_t = struct {
+using player_moved_t = struct player_moved_t {
     player_num_t player_id;
     position_t position;
 };
 
-using block_placed_t = struct {
+using block_placed_t = struct block_placed_t {
     position_t position;
 };
 
-
-using event_t = std::variant<bomb_placed_t, bomb_exploded_t, player_moved_t,
-                            block_placed_t>;
-using event_list_t = std::vector<event_t>;
-
-using game_turn_t = struct {
-    turn_t turn;
-    event_list_t events;
-};
-
 enum Direction {
     UP = 0,
     RIGHT = 1,
@@ -155,6 +145,13 @@ constexpr message_id_t SC_ACCEPTED_PLAYER = 1;
 constexpr message_id_t SC_GAME_STARTED = 2;
 constexpr message_id_t SC_TURN = 3;
 constexpr message_id_t SC_GAME_ENDED = 4;
+// Rozszerzenie protokołu wysyłane tylko przy resynchronizacji opóźnionego
+// klienta: klient ma wyczyścić planszę, bo kolejny komunikat turn jest
+// migawką stanu gry.
+constexpr message_id_t SC_RESYNC = 5;
+// Rozszerzenie protokołu wysyłane zaraz po migawce stanu gry: wyniki graczy
+// i liczniki bomb, których komunikat turn nie przenosi.
+constexpr message_id_t SC_GAME_STATE = 6;
 
 // Zdarzenia wysyłane od serwera do klienta.
 constexpr message_id_t BOMB_PLACED = 0;
@@ -0,0 +1,117 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+/* Szablon klasy implementującej nieblokującą kolejkę wielu producentów i
+ * jednego konsumenta. Producenci dopisują elementy jedną operacją exchange,
+ * bez żadnego zamka. Konsument czeka na elementy na liczniku atomowym, więc
+ * budzenie wymaga wywołania systemowego tylko wtedy, gdy konsument śpi.
+ * Metody pop, try_pop i pop_all może wywoływać tylko jeden wątek.
+ */
+template<class T>
+class MPSCQueue {
+private:
+    struct node {
+        std::atomic<node*> next;
+        T value;
+    };
+
+    std::atomic<node*> head; // Ostatnio dopisany element.
+    node *tail;              // Atrapa poprzedzająca najstarszy element.
+    std::atomic<uint32_t> pushes{0};
+
+    void push_node(node *n) {
+        node *prev = head.exchange(n, std::memory_order_acq_rel);
+        prev->next.store(n, std::memory_order_release);
+        pushes.fetch_add(1, std::memory_order_release);
+        pushes.notify_one();
+    }
+
+    /* Metoda czekająca, aż w kolejce pojawi się element. */
+    void wait_for_push() {
+        while (true) {
+            uint32_t seen = pushes.load(std::memory_order_acquire);
+            if (tail->next.load(std::memory_order_acquire) != nullptr)
+                return;
+            pushes.wait(seen, std::memory_order_acquire);
+        }
+    }
+
+public:
+    MPSCQueue() : head(new node{{nullptr}, T{}}) {
+        tail = head.load(std::memory_order_relaxed);
+    }
+
+    MPSCQueue(const MPSCQueue &) = delete;
+    MPSCQueue &operator=(const MPSCQueue &) = delete;
+
+    ~MPSCQueue() {
+        while (tail != nullptr) {
+            node *next = tail->next.load(std::memory_order_relaxed);
+            delete tail;
+            tail = next;
+        }
+    }
+
+    /* Metoda umieszcza element na końcu kolejki.
+     * argumenty:
+     * - v - element do wrzucenia na koniec kolejki
+     */
+    void push(T &v) {
+        push_node(new node{{nullptr}, v});
+    }
+
+    void push(T &&v) {
+        push_node(new node{{nullptr}, std::move(v)});
+    }
+
+    /* Metoda usuwa element z początku kolejki i go zwraca.
+     * return - wartość z początku kolejki lub nullopt, gdy kolejka jest pusta
+     *          albo producent jeszcze nie skończył dopisywać elementu.
+     */
+    std::optional<T> try_pop() {
+        node *next = tail->next.load(std::memory_order_acquire);
+        if (next == nullptr)
+            return std::nullopt;
+        std::optional<T> v = std::move(next->value);
+        delete tail;
+        tail = next;
+        return v;
+    }
+
+    /* Metoda usuwa element z początku kolejki i go zwraca. W przypadku,
+     * gdy kolejka jest pusta wątek jest wstrzymywany.
+     * return - wartość z początku kolejki.
+     */
+    T pop() {
+        while (true) {
+            if (auto v = try_pop())
+                return std::move(*v);
+            wait_for_push();
+        }
+    }
+
+    /* Metoda przenosi wszystkie dostępne elementy na koniec wektora out.
+     * W przypadku, gdy kolejka jest pusta wątek jest wstrzymywany do czasu
+     * pojawienia się choć jednego elementu.
+     * return - liczba przeniesionych elementów
+     */
+    size_t pop_all(std::vector<T> &out) {
+        size_t count = 0;
+        while (count == 0) {
+            while (auto v = try_pop()) {
+                out.push_back(std::move(*v));
+                count++;
+            }
+            if (count == 0)
+                wait_for_push();
+        }
+        return count;
+    }
+};
+
+#endif // MPSC_QUEUE_H
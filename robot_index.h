@@ -0,0 +1,115 @@
+#ifndef ROBOT_INDEX_H
+#define ROBOT_INDEX_H
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "message_types.h"
+#include "block_grid.h"
+
+// Klasa przechowująca indeks pól zajętych przez roboty. Roboty stojące na
+// jednym polu tworzą listę dwukierunkową zapisaną w tablicach next i prev,
+// indeksowanych numerem gracza, a dla każdego pola planszy indeks pamięta
+// pierwszego robota listy. Przestawienie robota to kilka przypisań, bez
+// alokacji pamięci, a roboty trafione przez wybuch znajduje się przeglądając
+// tylko pola w zasięgu wybuchu. Dla plansz większych niż
+// BlockGrid::DENSE_LIMIT pierwsze roboty pól są trzymane w słowniku.
+class RobotIndex {
+private:
+    // Numer gracza oznaczający brak robota. Graczy jest co najwyżej
+    // UINT8_MAX, więc nie jest numerem żadnego z nich.
+    static constexpr player_num_t NONE = UINT8_MAX;
+
+    const coords_t size_x;
+    const bool dense;
+    std::vector<player_num_t> head; // Pierwszy robot na każdym polu.
+    std::unordered_map<position_t, player_num_t, PositionHash> sparse_head;
+    std::array<player_num_t, UINT8_MAX> next;
+    std::array<player_num_t, UINT8_MAX> prev;
+    std::array<position_t, UINT8_MAX> cell; // Pole, na którym stoi robot.
+    std::vector<player_num_t> placed;       // Roboty obecne w indeksie.
+
+    player_num_t first(const position_t p) const {
+        if (dense)
+            return head[size_t{p.y} * size_x + p.x];
+        auto it = sparse_head.find(p);
+        return it == sparse_head.end() ? NONE : it->second;
+    }
+
+    void set_first(const position_t p, const player_num_t id) {
+        if (dense)
+            head[size_t{p.y} * size_x + p.x] = id;
+        else if (id == NONE)
+            sparse_head.erase(p);
+        else
+            sparse_head[p] = id;
+    }
+
+    void link(const player_num_t id, const position_t p) {
+        const player_num_t old = first(p);
+        next[id] = old;
+        prev[id] = NONE;
+        if (old != NONE)
+            prev[old] = id;
+        set_first(p, id);
+        cell[id] = p;
+    }
+
+    void unlink(const player_num_t id) {
+        if (prev[id] != NONE)
+            next[prev[id]] = next[id];
+        else
+            set_first(cell[id], next[id]);
+        if (next[id] != NONE)
+            prev[next[id]] = prev[id];
+    }
+
+    template<class F>
+    void for_each_on(const position_t p, F f) const {
+        for (player_num_t id = first(p); id != NONE; id = next[id])
+            f(id);
+    }
+
+public:
+    RobotIndex(const coords_t _size_x, const coords_t size_y) :
+            size_x(_size_x),
+            dense(size_t{_size_x} * size_y <= BlockGrid::DENSE_LIMIT) {
+        if (dense)
+            head.assign(size_t{_size_x} * size_y, NONE);
+        placed.reserve(UINT8_MAX);
+    }
+
+    // Metoda stawiająca robota id na polu p.
+    void add(const player_num_t id, const position_t p) {
+        link(id, p);
+        placed.push_back(id);
+    }
+
+    // Metoda przenosząca robota id na pole to.
+    void move(const player_num_t id, const position_t to) {
+        unlink(id);
+        link(id, to);
+    }
+
+    void clear() {
+        for (const auto id: placed)
+            set_first(cell[id], NONE);
+        placed.clear();
+    }
+
+    // Metoda wywołująca f dla każdego robota w zasięgu wybuchu b.
+    template<class F>
+    void for_each_in(const blast_t &b, F f) const {
+        const position_t c = b.center;
+        for (size_t x = c.x - b.left; x <= size_t{c.x} + b.right; x++)
+            for_each_on(position_t{static_cast<coords_t>(x), c.y}, f);
+        for (size_t y = c.y - b.down; y <= size_t{c.y} + b.up; y++) {
+            if (y != c.y)
+                for_each_on(position_t{c.x, static_cast<coords_t>(y)}, f);
+        }
+    }
+};
+
+#endif // ROBOT_INDEX_H
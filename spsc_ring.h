@@ -0,0 +1,52 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Bufor cykliczny o stałej pojemności N dla jednego producenta i jednego
+// konsumenta, bez blokad. Elementy nie są tworzone ani niszczone przy
+// wstawianiu i zdejmowaniu: producent dostaje miejsce (claim), wypełnia je i
+// je publikuje (commit), a konsument czyta element z początku (front) i go
+// zwalnia (pop). Dzięki temu element może trzymać bufory używane ponownie.
+// Kilku producentów albo kilku konsumentów może korzystać z bufora, jeżeli
+// zapewnią, że nie robią tego jednocześnie, np. zajmując wspólny mutex.
+template<class T, size_t N>
+class SPSCRing {
+private:
+    std::array<T, N> slots;
+    std::atomic<size_t> head{0}; // Liczba zdjętych elementów.
+    std::atomic<size_t> tail{0}; // Liczba opublikowanych elementów.
+
+public:
+    // Metoda zwracająca wolne miejsce na kolejny element lub nullptr, jeżeli
+    // bufor jest pełny. Wywoływana przez producenta.
+    T *claim() {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == N)
+            return nullptr;
+        return &slots[t % N];
+    }
+
+    // Metoda publikująca element zapisany w miejscu zwróconym przez claim.
+    void commit() {
+        tail.store(tail.load(std::memory_order_relaxed) + 1);
+    }
+
+    // Metoda zwracająca pierwszy element lub nullptr, jeżeli bufor jest
+    // pusty. Wywoływana przez konsumenta.
+    T *front() {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load())
+            return nullptr;
+        return &slots[h % N];
+    }
+
+    // Metoda zwalniająca pierwszy element.
+    void pop() {
+        head.store(head.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_release);
+    }
+};
+
+#endif // SPSC_RING_H
@@ -0,0 +1,264 @@
+#ifndef TICK_SCHEDULER_H
+#define TICK_SCHEDULER_H
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <boost/chrono.hpp>
+#include <boost/thread.hpp>
+
+/* Klasa uruchamiająca zadania okresowe (np. tury gier) na wspólnej puli
+ * wątków. Terminy zadań są trzymane w kole czasowym o rozdzielczości
+ * resolution, obsługiwanym przez jeden wątek zegara. Zadania, których termin
+ * minął, trafiają do kolejek wątków roboczych. Wątek, który nie ma nic do
+ * zrobienia, podkrada zadania z kolejek innych wątków, więc długie zadanie
+ * nie opóźnia zadań czekających za nim w tej samej kolejce.
+ * Zadanie zwraca termin swojego kolejnego uruchomienia albo nullopt, jeżeli
+ * nie chce być ponownie uruchomione do czasu wywołania schedule. Jedno
+ * zadanie nigdy nie jest uruchamiane przez dwa wątki jednocześnie, o ile
+ * schedule nie jest wywoływane dla zadania, które ma już wyznaczony termin.
+ */
+class TickScheduler {
+public:
+    using clock = boost::chrono::steady_clock;
+    using task_t = std::function<std::optional<clock::time_point>()>;
+    using task_id_t = size_t;
+
+private:
+    struct wheel_entry_t {
+        uint64_t tick; // Numer tyknięcia koła, w którym mija termin.
+        task_id_t task;
+    };
+
+    // Kolejka zadań jednego wątku roboczego.
+    struct worker_queue_t {
+        boost::mutex mutex;
+        std::deque<task_id_t> tasks;
+    };
+
+    const clock::duration resolution;
+    const clock::time_point start;
+    std::vector<task_t> tasks;
+
+    // Koło czasowe, chronione przez wheel_mutex.
+    boost::mutex wheel_mutex;
+    boost::condition_variable for_timer;
+    std::vector<std::vector<wheel_entry_t>> wheel;
+    uint64_t current_tick; // Ostatnie obsłużone tyknięcie.
+    uint64_t earliest;     // Najwcześniejsze tyknięcie z terminem w kole.
+    size_t timers;         // Liczba terminów w kole.
+
+    std::vector<std::unique_ptr<worker_queue_t>> queues;
+    size_t next_queue; // Kolejka, do której trafi następne zadanie.
+    // Liczba zadań czekających w kolejkach wątków roboczych.
+    std::atomic<size_t> ready{0};
+    boost::mutex idle_mutex;
+    boost::condition_variable for_work;
+
+    std::atomic<bool> stopping{false};
+    boost::thread_group threads;
+
+    // Metoda przekazująca zadanie do kolejki wątku roboczego.
+    void make_ready(const task_id_t task) {
+        worker_queue_t &queue = *queues[next_queue];
+        next_queue = (next_queue + 1) % queues.size();
+        {
+            boost::lock_guard<boost::mutex> guard(queue.mutex);
+            queue.tasks.push_back(task);
+        }
+        {
+            boost::lock_guard<boost::mutex> guard(idle_mutex);
+            ready++;
+        }
+        for_work.notify_one();
+    }
+
+    // Metoda wyznaczająca najwcześniejsze tyknięcie z terminem w niepustym
+    // kole. Przegląda przegródki od current_tick do przodu i kończy na
+    // pierwszym terminie z bieżącego obrotu koła, a jeżeli takiego nie ma,
+    // zwraca najmniejszy termin z dalszych obrotów.
+    uint64_t find_earliest() const {
+        uint64_t best = UINT64_MAX;
+        for (uint64_t tick = current_tick + 1;
+             tick <= current_tick + wheel.size(); tick++) {
+            for (const auto &entry: wheel[tick % wheel.size()]) {
+                if (entry.tick == tick)
+                    return tick;
+                best = std::min(best, entry.tick);
+            }
+        }
+        return best;
+    }
+
+    // Metoda wątku zegara. Wątek śpi do najwcześniejszego terminu w kole,
+    // przesuwa koło od razu do jego tyknięcia i oddaje wątkom roboczym
+    // zadania, których termin minął. schedule budzi wątek, jeżeli pojawi
+    // się wcześniejszy termin.
+    void run_timer() {
+        boost::unique_lock<boost::mutex> lock(wheel_mutex);
+        while (!stopping) {
+            if (timers == 0) {
+                for_timer.wait(lock);
+                continue;
+            }
+
+            clock::time_point next = start
+                + static_cast<clock::rep>(earliest) * resolution;
+            if (clock::now() < next) {
+                for_timer.wait_until(lock, next);
+                continue;
+            }
+            current_tick = earliest;
+
+            auto &slot = wheel[current_tick % wheel.size()];
+            for (size_t i = 0; i < slot.size();) {
+                if (slot[i].tick <= current_tick) {
+                    make_ready(slot[i].task);
+                    slot[i] = slot.back();
+                    slot.pop_back();
+                    timers--;
+                }
+                else {
+                    i++;
+                }
+            }
+            earliest = find_earliest();
+        }
+    }
+
+    // Metoda pobierająca zadanie z kolejki wątku self, a jeżeli jest pusta,
+    // podkradająca zadanie z końca kolejki innego wątku.
+    std::optional<task_id_t> take_task(const size_t self) {
+        for (size_t i = 0; i < queues.size(); i++) {
+            worker_queue_t &queue = *queues[(self + i) % queues.size()];
+            boost::lock_guard<boost::mutex> guard(queue.mutex);
+            if (queue.tasks.empty()) continue;
+            task_id_t task;
+            if (i == 0) {
+                task = queue.tasks.front();
+                queue.tasks.pop_front();
+            }
+            else {
+                task = queue.tasks.back();
+                queue.tasks.pop_back();
+            }
+            ready--;
+            return task;
+        }
+        return std::nullopt;
+    }
+
+    // Metoda wątku roboczego o numerze self.
+    void run_worker(const size_t self) {
+        while (true) {
+            {
+                boost::unique_lock<boost::mutex> lock(idle_mutex);
+                while (ready == 0 && !stopping)
+                    for_work.wait(lock);
+                if (stopping) return;
+            }
+            if (auto task = take_task(self)) {
+                if (auto next = tasks[*task]())
+                    schedule(*task, *next);
+            }
+        }
+    }
+
+    uint64_t tick_of(const clock::time_point when) const {
+        if (when <= start) return 0;
+        // Zaokrąglenie w górę, żeby zadanie nie ruszyło przed terminem.
+        return static_cast<uint64_t>(
+            (when - start + resolution - clock::duration(1)) / resolution);
+    }
+
+public:
+    /* Konstruktor schedulera.
+     * argumenty:
+     * - workers - liczba wątków roboczych
+     * - _resolution - długość jednego tyknięcia koła czasowego
+     * - slots - liczba przegródek koła czasowego
+     */
+    explicit TickScheduler(const size_t workers,
+                           const clock::duration _resolution
+                               = boost::chrono::milliseconds(1),
+                           const size_t slots = 1024) :
+            resolution(_resolution), start(clock::now()), wheel(slots),
+            current_tick(0), earliest(0), timers(0), next_queue(0) {
+        for (size_t i = 0; i < std::max<size_t>(1, workers); i++)
+            queues.push_back(std::make_unique<worker_queue_t>());
+    }
+
+    TickScheduler(const TickScheduler &) = delete;
+    TickScheduler &operator=(const TickScheduler &) = delete;
+
+    ~TickScheduler() {
+        stopping = true;
+        {
+            boost::lock_guard<boost::mutex> guard(wheel_mutex);
+            for_timer.notify_all();
+        }
+        {
+            boost::lock_guard<boost::mutex> guard(idle_mutex);
+            for_work.notify_all();
+        }
+        threads.join_all();
+    }
+
+    /* Metoda rejestrująca zadanie. Wszystkie zadania należy zarejestrować
+     * przed wywołaniem start_threads.
+     * return - id zadania
+     */
+    task_id_t add(task_t task) {
+        tasks.push_back(std::move(task));
+        return tasks.size() - 1;
+    }
+
+    /* Metoda uruchamiająca wątek zegara i wątki robocze. */
+    void start_threads() {
+        threads.create_thread([this]() { run_timer(); });
+        for (size_t i = 0; i < queues.size(); i++)
+            threads.create_thread([this, i]() { run_worker(i); });
+    }
+
+    /* Metoda wyznaczająca termin uruchomienia zadania.
+     * argumenty:
+     * - task - id zadania
+     * - when - termin uruchomienia
+     */
+    void schedule(const task_id_t task, const clock::time_point when) {
+        boost::lock_guard<boost::mutex> guard(wheel_mutex);
+        if (timers == 0) {
+            // Koło stało, więc pomijamy tyknięcia, które już minęły.
+            uint64_t now_tick = tick_of(clock::now());
+            if (now_tick > 0)
+                current_tick = std::max(current_tick, now_tick - 1);
+        }
+        // Termin, który już minął, jest obsługiwany w najbliższym tyknięciu.
+        uint64_t tick = std::max(tick_of(when), current_tick + 1);
+        wheel[tick % wheel.size()].push_back({tick, task});
+        if (timers++ == 0 || tick < earliest) {
+            earliest = tick;
+            for_timer.notify_one();
+        }
+    }
+
+    /* Metoda przekazująca zadanie wątkom roboczym od razu, z pominięciem
+     * koła czasowego. Zadanie uruchamiane w ten sposób może działać
+     * jednocześnie na kilku wątkach, jeżeli zostanie przekazane ponownie,
+     * zanim się skończy.
+     * argumenty:
+     * - task - id zadania
+     */
+    void post(const task_id_t task) {
+        boost::lock_guard<boost::mutex> guard(wheel_mutex);
+        make_ready(task);
+    }
+};
+
+#endif // TICK_SCHEDULER_H
@@ -0,0 +1,98 @@
+#ifndef TURN_EVENTS_H
+#define TURN_EVENTS_H
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "message_types.h"
+
+// Zdarzenie tury. Dla BOMB_EXPLODED zniszczone roboty i bloki leżą we
+// wspólnych tablicach TurnEvents, w przedziałach [robots_begin, robots_end)
+// i [blocks_begin, blocks_end).
+struct event_record_t {
+    message_id_t type; // BOMB_PLACED, BOMB_EXPLODED, PLAYER_MOVED, BLOCK_PLACED
+    uint32_t id;       // Id bomby albo gracza.
+    position_t position;
+    uint32_t robots_begin;
+    uint32_t robots_end;
+    uint32_t blocks_begin;
+    uint32_t blocks_end;
+};
+
+// Klasa przechowująca zdarzenia jednej tury w trzech płaskich tablicach:
+// rekordach zdarzeń, zniszczonych robotach i zniszczonych blokach. Obiekt jest
+// używany ponownie w każdej turze, a clear() zachowuje zaalokowaną pamięć,
+// więc po kilku pierwszych turach zapisywanie zdarzeń nie alokuje pamięci.
+class TurnEvents {
+private:
+    std::vector<event_record_t> events;
+    std::vector<player_num_t> robots;
+    std::vector<position_t> blocks;
+
+    void add(const message_id_t type, const uint32_t id,
+             const position_t position) {
+        auto robots_size = static_cast<uint32_t>(robots.size());
+        auto blocks_size = static_cast<uint32_t>(blocks.size());
+        events.push_back({type, id, position, robots_size, robots_size,
+                          blocks_size, blocks_size});
+    }
+
+public:
+    void bomb_placed(const bomb_id_t bomb_id, const position_t position) {
+        add(BOMB_PLACED, bomb_id, position);
+    }
+
+    // Metoda dodająca zdarzenie BOMB_EXPLODED. Kolejne wywołania
+    // robot_destroyed i block_destroyed dotyczą tego zdarzenia.
+    void bomb_exploded(const bomb_id_t bomb_id, const position_t position) {
+        add(BOMB_EXPLODED, bomb_id, position);
+    }
+
+    void robot_destroyed(const player_num_t player_id) {
+        robots.push_back(player_id);
+        events.back().robots_end++;
+    }
+
+    void block_destroyed(const position_t position) {
+        blocks.push_back(position);
+        events.back().blocks_end++;
+    }
+
+    void player_moved(const player_num_t player_id, const position_t position) {
+        add(PLAYER_MOVED, player_id, position);
+    }
+
+    void block_placed(const position_t position) {
+        add(BLOCK_PLACED, 0, position);
+    }
+
+    void clear() {
+        events.clear();
+        robots.clear();
+        blocks.clear();
+    }
+
+    const std::vector<event_record_t> &records() const {
+        return events;
+    }
+
+    std::span<const player_num_t> robots_of(const event_record_t &e) const {
+        return {robots.data() + e.robots_begin, e.robots_end - e.robots_begin};
+    }
+
+    std::span<const position_t> blocks_of(const event_record_t &e) const {
+        return {blocks.data() + e.blocks_begin, e.blocks_end - e.blocks_begin};
+    }
+
+    // Metoda zwracająca bloki zniszczone we wszystkich wybuchach tury.
+    const std::vector<position_t> &destroyed_blocks() const {
+        return blocks;
+    }
+};
+
+using game_turn_t = struct game_turn_t {
+    turn_t turn;
+    TurnEvents events;
+};
+
+#endif // TURN_EVENTS_H
@@ -0,0 +1,59 @@
+#ifndef TURN_HISTORY_H
+#define TURN_HISTORY_H
+#include <cstddef>
+#include <vector>
+
+#include "connection.h"
+
+// Klasa przechowująca historię gry jako zakodowane komunikaty ułożone jeden
+// za drugim w ciągłym buforze. Historia zaczyna się od migawki stanu gry,
+// po której następują kolejne tury. Bufor jest rezerwowany z góry, z
+// zapasem slack ponad limit pamięci, więc dopisanie tury nie alokuje
+// pamięci. Zapas powinien pomieścić wszystkie tury, które mogą zostać
+// dopisane od przekroczenia limitu do zapisania kolejnej migawki.
+class TurnHistory {
+private:
+    flex_buf_t arena;
+    const size_t capacity; // Maksymalny rozmiar historii w bajtach.
+    const size_t slack;    // Zapas ponad limit pamięci w bajtach.
+
+public:
+    explicit TurnHistory(const size_t _capacity, const size_t _slack = 0) :
+            capacity(_capacity), slack(_slack) {
+        arena.reserve(capacity + slack);
+    }
+
+    // Metoda dopisująca turę na koniec historii. Tura, która przekracza
+    // limit pamięci, jest dopisywana, o ile mieści się w zapasie, żeby
+    // historia pozostała ciągła do czasu zapisania kolejnej migawki. Tura,
+    // która nie mieści się w zarezerwowanym buforze, nie jest dopisywana.
+    // turn - zakodowana tura
+    // return - false, jeżeli historia przekroczyła limit pamięci.
+    //          Należy wtedy jak najszybciej zastąpić ją nową migawką.
+    bool append(const flex_buf_t &turn) {
+        if (arena.size() + turn.size() > arena.capacity())
+            return false;
+        arena.insert(arena.end(), turn.begin(), turn.end());
+        return arena.size() <= capacity;
+    }
+
+    // Metoda zastępująca całą historię migawką stanu gry. Migawka jest
+    // zapisywana nawet wtedy, gdy sama przekracza limit pamięci. Bufor jest
+    // wtedy powiększany tak, żeby za migawką zmieścił się cały zapas.
+    // keyframe - zakodowana migawka
+    void set_keyframe(const flex_buf_t &keyframe) {
+        arena.reserve(keyframe.size() + slack);
+        arena.assign(keyframe.begin(), keyframe.end());
+    }
+
+    void clear() {
+        arena.clear();
+    }
+
+    // Metoda zwracająca bajty historii, gotowe do wysłania klientowi.
+    const flex_buf_t &contents() const {
+        return arena;
+    }
+};
+
+#endif // TURN_HISTORY_H